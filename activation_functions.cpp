@@ -4,15 +4,90 @@
 //
 //  Created by Richard Dalley on 2025-01-09.
 //
-#ifndef ACTIVATION_FUNCTIONS_H
-#define ACTIVATION_FUNCTIONS_H
-
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <stdexcept>
+#include <vector>
 #include "activation_functions.h" // Your Matrix class
 #include "matrix.h" // Your Matrix class
+#include "simd.h"
 
 namespace NeuralNetwork{
     namespace ActivationFunctions {
+        namespace {
+            // Samples of f for the Table tier: intervals + 1 points spanning [lo, hi] plus a
+            // repeat of the last one, so interpolating at hi never reads past the end
+            struct LookupTable {
+                float lo;
+                float invStep;
+                size_t intervals;
+                std::vector<float> values;
+
+                LookupTable(double (*f)(double), float lo, float hi, size_t intervals)
+                    : lo(lo), invStep(static_cast<float>(intervals) / (hi - lo)), intervals(intervals), values(intervals + 2) {
+                    double step = (static_cast<double>(hi) - lo) / intervals;
+                    for (size_t i = 0; i <= intervals; ++i) {
+                        values[i] = static_cast<float>(f(lo + i * step));
+                    }
+                    values[intervals + 1] = values[intervals];
+                }
+
+                void apply(const Simd::Kernels& kernels, const float* in, float* out, size_t n) const {
+                    kernels.lookup(values.data(), intervals, lo, invStep, in, out, n);
+                }
+            };
+
+            double sigmoidReference(double x) {
+                return 1.0 / (1.0 + std::exp(-x));
+            }
+
+            double tanhReference(double x) {
+                return std::tanh(x);
+            }
+
+            // Past these ranges both functions are within 2e-7 of their asymptotes
+            const LookupTable& sigmoidTable() {
+                static const LookupTable table(sigmoidReference, -16.0f, 16.0f, 4096);
+                return table;
+            }
+
+            const LookupTable& tanhTable() {
+                static const LookupTable table(tanhReference, -8.0f, 8.0f, 4096);
+                return table;
+            }
+
+            // applySpan on a given kernel table, so the accuracy check can run every instruction set
+            void applySpanWith(const Simd::Kernels& kernels, Activation activation, const float* in, float* out, size_t n, Precision precision) {
+                switch (activation) {
+                    case Activation::Sigmoid:
+                        if (precision == Precision::Exact) {
+                            std::transform(in, in + n, out, sigmoid);
+                        } else if (precision == Precision::Table) {
+                            sigmoidTable().apply(kernels, in, out, n);
+                        } else {
+                            kernels.sigmoid(in, out, n);
+                        }
+                        break;
+                    case Activation::Tanh:
+                        if (precision == Precision::Exact) {
+                            std::transform(in, in + n, out, tanh);
+                        } else if (precision == Precision::Table) {
+                            tanhTable().apply(kernels, in, out, n);
+                        } else {
+                            kernels.tanh(in, out, n);
+                        }
+                        break;
+                    case Activation::Relu:
+                        kernels.relu(in, out, n);
+                        break;
+                    case Activation::LeakyRelu:
+                        kernels.leakyRelu(in, leakyReluSlope, out, n);
+                        break;
+                }
+            }
+        }
+
         // Sigmoid activation function
         float sigmoid(float x) {
             return 1.0f / (1.0f + std::exp(-x));
@@ -20,8 +95,7 @@ namespace NeuralNetwork{
 
         // Derivative of sigmoid (for backpropagation)
         float sigmoidDerivative(float x) {
-            float s = sigmoid(x);
-            return s * (1 - s);
+            return sigmoidDerivativeFromOutput(sigmoid(x));
         }
 
         // ReLU activation function
@@ -37,16 +111,154 @@ namespace NeuralNetwork{
             return std::tanh(x);
         }
         float tanhDerivative(float x) {
-            float t = tanh(x);
-            return 1 - t * t;
+            return tanhDerivativeFromOutput(tanh(x));
         }
         float leakyRelu(float x) {
-            return (x > 0) ? x : 0.01f * x;
+            return (x > 0) ? x : leakyReluSlope * x;
         }
         float leakyReluDerivative(float x) {
-            return (x > 0) ? 1.0f : 0.01f;
+            return (x > 0) ? 1.0f : leakyReluSlope;
         }
-        
+
+        Precision precisionFromName(const std::string& name) {
+            if (name == "exact") {
+                return Precision::Exact;
+            }
+            if (name == "polynomial") {
+                return Precision::Polynomial;
+            }
+            if (name == "table") {
+                return Precision::Table;
+            }
+            throw std::invalid_argument("Unknown activation precision: " + name);
+        }
+
+        const char* precisionName(Precision precision) {
+            switch (precision) {
+                case Precision::Exact:
+                    return "exact";
+                case Precision::Table:
+                    return "table";
+                default:
+                    return "polynomial";
+            }
+        }
+
+        // Dispatch once per span to the kernel table, never per element
+        void applySpan(Activation activation, const float* in, float* out, size_t n, Precision precision) {
+            applySpanWith(Simd::kernels(), activation, in, out, n, precision);
+        }
+
+        void apply(NeuralNetwork::Matrix<float>& mat, Activation activation, Precision precision) {
+            applyInto(mat, mat, activation, precision);
+        }
+
+        // Apply a built-in activation into a preallocated matrix (dst may be mat)
+        void applyInto(const NeuralNetwork::Matrix<float>& mat, NeuralNetwork::Matrix<float>& dst, Activation activation, Precision precision) {
+            dst.resize(mat.getRows(), mat.getCols());
+            size_t n = mat.getRows() * mat.getCols();
+            if (n > 0) {
+                applySpan(activation, &*mat.begin(), &*dst.begin(), n, precision);
+            }
+        }
+
+        void denseSpan(size_t rows, size_t cols, const float* weights, size_t ld, const float* x, const float* bias, float* out,
+                       Activation activation, Precision precision) {
+            Gemm::gemvEpilogue(rows, cols, weights, ld, x, out, [=](float* block, float* dst, size_t count) {
+                if (bias != nullptr) {
+                    Simd::kernels().add(block, bias + (dst - out), block, count);
+                }
+                applySpan(activation, block, dst, count, precision);
+            });
+        }
+
+        void denseInto(const NeuralNetwork::Matrix<float>& weights, const NeuralNetwork::Matrix<float>& x, NeuralNetwork::Matrix<float>& dst,
+                       Activation activation, Precision precision, const NeuralNetwork::Matrix<float>* bias) {
+            if (x.getRows() * x.getCols() != weights.getCols() || (x.getRows() != 1 && x.getCols() != 1)) {
+                throw std::invalid_argument("dense: vector length must match the weight columns");
+            }
+            if (bias != nullptr && bias->getRows() * bias->getCols() != weights.getRows()) {
+                throw std::invalid_argument("dense: bias length must match the weight rows");
+            }
+
+            dst.resize(weights.getRows(), 1);
+            auto raw = [](const NeuralNetwork::Matrix<float>& m) { return (m.begin() == m.end()) ? nullptr : &*m.begin(); };
+            float* out = (dst.begin() == dst.end()) ? nullptr : &*dst.begin();
+            denseSpan(weights.getRows(), weights.getCols(), raw(weights), weights.getCols(), raw(x), (bias != nullptr) ? raw(*bias) : nullptr, out,
+                      activation, precision);
+        }
+
+        // Plain inline transforms the compiler can vectorise; no std::function in the loop
+        void applyDerivativeInto(const NeuralNetwork::Matrix<float>& outputs, NeuralNetwork::Matrix<float>& dst, Activation activation) {
+            dst.resize(outputs.getRows(), outputs.getCols());
+            switch (activation) {
+                case Activation::Sigmoid:
+                    std::transform(outputs.begin(), outputs.end(), dst.begin(), [](float y) { return sigmoidDerivativeFromOutput(y); });
+                    break;
+                case Activation::Tanh:
+                    std::transform(outputs.begin(), outputs.end(), dst.begin(), [](float y) { return tanhDerivativeFromOutput(y); });
+                    break;
+                case Activation::Relu:
+                    std::transform(outputs.begin(), outputs.end(), dst.begin(), [](float y) { return (y > 0) ? 1.0f : 0.0f; });
+                    break;
+                case Activation::LeakyRelu:
+                    std::transform(outputs.begin(), outputs.end(), dst.begin(), [](float y) { return (y > 0) ? 1.0f : leakyReluSlope; });
+                    break;
+            }
+        }
+
+        double accuracyBound(Precision precision) {
+            return (precision == Precision::Table) ? tableAbsoluteError : polynomialRelativeError;
+        }
+
+        AccuracyReport measureAccuracy(Activation activation, Precision precision, Simd::Isa isa) {
+            const Simd::Kernels kernels = Simd::kernelsFor(isa);
+            const size_t samples = 1 << 20;
+            const size_t repeats = 20;
+            std::vector<float> in(samples);
+            std::vector<float> out(samples);
+            for (size_t i = 0; i < samples; ++i) {
+                in[i] = -20.0f + 40.0f * static_cast<float>(i) / (samples - 1);
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < repeats; ++r) {
+                applySpanWith(kernels, activation, in.data(), out.data(), samples, precision);
+            }
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+            AccuracyReport report = {0.0, 0.0, elapsed.count() / (repeats * samples), accuracyBound(precision), false};
+            for (size_t i = 0; i < samples; ++i) {
+                double x = in[i];
+                double expected = 0.0;
+                switch (activation) {
+                    case Activation::Sigmoid:
+                        expected = sigmoidReference(x);
+                        break;
+                    case Activation::Tanh:
+                        expected = tanhReference(x);
+                        break;
+                    case Activation::Relu:
+                        expected = (x > 0) ? x : 0.0;
+                        break;
+                    case Activation::LeakyRelu:
+                        expected = (x > 0) ? x : leakyReluSlope * x;
+                        break;
+                }
+                double error = std::fabs(out[i] - expected);
+                report.maxAbsoluteError = std::max(report.maxAbsoluteError, error);
+                if (expected != 0.0) {
+                    report.maxRelativeError = std::max(report.maxRelativeError, error / std::fabs(expected));
+                }
+            }
+            // The table interpolates between samples, so its error is absolute; it is not relative
+            // in the tails, where sigmoid heads to zero
+            double measured = (precision == Precision::Table) ? report.maxAbsoluteError : report.maxRelativeError;
+            report.withinBound = measured <= report.bound;
+            return report;
+        }
+
+        // Slow path for user-defined functions: one indirect call per element
         // Apply any activation function element-wise to a matrix
         void apply(NeuralNetwork::Matrix<float>& mat, std::function<float(float)> func) {
             for (size_t i = 0; i < mat.getRows(); ++i) {
@@ -56,6 +268,12 @@ namespace NeuralNetwork{
             }
         }
         
+        // Apply an activation function element-wise into a preallocated matrix (dst may be mat)
+        void applyInto(const NeuralNetwork::Matrix<float>& mat, NeuralNetwork::Matrix<float>& dst, std::function<float(float)> func) {
+            dst.resize(mat.getRows(), mat.getCols());
+            std::transform(mat.begin(), mat.end(), dst.begin(), func);
+        }
+
         NeuralNetwork::Matrix<float> applyNew(const NeuralNetwork::Matrix<float>& mat, std::function<float(float)> func) {
             Matrix<float> result(mat.getRows(), mat.getCols());  // Create a new matrix with the same dimensions
             for (size_t i = 0; i < mat.getRows(); ++i) {
@@ -68,5 +286,3 @@ namespace NeuralNetwork{
     };
 }
 
-#endif // ACTIVATION_FUNCTIONS_H
-
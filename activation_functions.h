@@ -9,7 +9,9 @@
 #define ACTIVATION_FUNCTIONS_H
 
 #include <functional>
+#include <string>
 #include "matrix.h" // Your Matrix class
+#include "simd.h"
 namespace NeuralNetwork{
     namespace ActivationFunctions {
         // Function declarations
@@ -22,8 +24,70 @@ namespace NeuralNetwork{
         float leakyRelu(float x);
         float leakyReluDerivative(float x);
 
+        // Derivatives in terms of the activation's output y = f(x), which backpropagation
+        // already has, so nothing is recomputed
+        inline float sigmoidDerivativeFromOutput(float y) { return y * (1.0f - y); }
+        inline float tanhDerivativeFromOutput(float y) { return 1.0f - y * y; }
+
+        // Built-in activations with vectorised span kernels (see simd.h). Prefer these over
+        // the std::function overloads, which cost an indirect call per element and cannot be
+        // vectorised; those remain for user-defined functions.
+        enum class Activation { Sigmoid, Tanh, Relu, LeakyRelu };
+
+        // Slope of leakyRelu for negative inputs
+        constexpr float leakyReluSlope = 0.01f;
+
+        // Accuracy tier for sigmoid and tanh (relu and leakyRelu are exact in every tier):
+        //   Exact      - libm, one element at a time
+        //   Polynomial - vectorised Cephes-style approximations, within ~3e-7 relative error
+        //   Table      - vectorised linear interpolation in a 4096-interval table, within
+        //                ~2e-6 absolute error (relative error grows in the saturated tails)
+        enum class Precision { Exact, Polynomial, Table };
+
+        // The documented bounds measureAccuracy checks: relative error for Exact and Polynomial,
+        // absolute error for Table
+        constexpr double polynomialRelativeError = 3e-7;
+        constexpr double tableAbsoluteError = 2e-6;
+
+        // "exact", "polynomial" or "table"; throws std::invalid_argument for anything else
+        Precision precisionFromName(const std::string& name);
+        const char* precisionName(Precision precision);
+
+        // out[i] = f(in[i]) for i < n; out may be in
+        void applySpan(Activation activation, const float* in, float* out, size_t n, Precision precision = Precision::Polynomial);
+        void apply(NeuralNetwork::Matrix<float>& mat, Activation activation, Precision precision = Precision::Polynomial);
+        void applyInto(const NeuralNetwork::Matrix<float>& mat, NeuralNetwork::Matrix<float>& dst, Activation activation, Precision precision = Precision::Polynomial);
+
+        // Fused layer forward pass: out = f(weights x + bias) for rows x cols row-major weights
+        // with leading dimension ld. Blocks of dot products get the bias and activation
+        // applied before they are stored, so the pre-activations never reach memory.
+        // bias may be null.
+        void denseSpan(size_t rows, size_t cols, const float* weights, size_t ld, const float* x, const float* bias, float* out,
+                       Activation activation, Precision precision = Precision::Polynomial);
+        // Matrix form for a column vector x; dst becomes weights.getRows() x 1. bias, when
+        // given, must hold one value per row of weights.
+        void denseInto(const NeuralNetwork::Matrix<float>& weights, const NeuralNetwork::Matrix<float>& x, NeuralNetwork::Matrix<float>& dst,
+                       Activation activation, Precision precision = Precision::Polynomial, const NeuralNetwork::Matrix<float>* bias = nullptr);
+
+        // dst = f'(x) computed from outputs = f(x); dst may be outputs
+        void applyDerivativeInto(const NeuralNetwork::Matrix<float>& outputs, NeuralNetwork::Matrix<float>& dst, Activation activation);
+
+        // Error of one tier on one instruction set against double-precision libm over a dense
+        // grid on [-20, 20], its throughput on that grid, and whether the error is within the
+        // tier's bound. isa must be no higher than Simd::supportedIsa().
+        struct AccuracyReport {
+            double maxAbsoluteError;
+            double maxRelativeError;
+            double nanosecondsPerElement;
+            double bound;
+            bool withinBound;
+        };
+        double accuracyBound(Precision precision);
+        AccuracyReport measureAccuracy(Activation activation, Precision precision, Simd::Isa isa = Simd::activeIsa());
+
         void apply(NeuralNetwork::Matrix<float>& mat, std::function<float(float)> func);
         NeuralNetwork::Matrix<float> applyNew(const NeuralNetwork::Matrix<float>& mat, std::function<float(float)> func);
+        void applyInto(const NeuralNetwork::Matrix<float>& mat, NeuralNetwork::Matrix<float>& dst, std::function<float(float)> func);
     };
 }
 
@@ -0,0 +1,72 @@
+//
+//  allocation_counter.cpp
+//  NeuralNetwork
+//
+//  Replaces the global operator new / delete when NN_COUNT_ALLOCATIONS is defined.
+//  The array and nothrow forms fall through to these in the standard library.
+//
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "allocation_counter.h"
+
+namespace NeuralNetwork{
+namespace Debug {
+#if defined(NN_COUNT_ALLOCATIONS)
+    static std::atomic<size_t> allocationCount{0};
+
+    bool countingAllocations() {
+        return true;
+    }
+
+    size_t heapAllocations() {
+        return allocationCount.load(std::memory_order_relaxed);
+    }
+#else
+    bool countingAllocations() {
+        return false;
+    }
+
+    size_t heapAllocations() {
+        return 0;
+    }
+#endif
+}
+}
+
+#if defined(NN_COUNT_ALLOCATIONS)
+void* operator new(std::size_t size) {
+    NeuralNetwork::Debug::allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    NeuralNetwork::Debug::allocationCount.fetch_add(1, std::memory_order_relaxed);
+    size_t align = static_cast<size_t>(alignment);
+    // aligned_alloc wants the size rounded up to a multiple of the alignment
+    size_t rounded = (size + align - 1) / align * align;
+    if (void* p = std::aligned_alloc(align, rounded == 0 ? align : rounded)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+#endif
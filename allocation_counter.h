@@ -0,0 +1,24 @@
+//
+//  allocation_counter.h
+//  NeuralNetwork
+//
+//  Debug counter of global heap allocations, used to check that the steady-state
+//  training loop does not allocate. Only active when built with -DNN_COUNT_ALLOCATIONS=ON,
+//  which replaces the global operator new; otherwise the counter always reads zero.
+//
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+namespace NeuralNetwork{
+namespace Debug {
+    // True when this build counts allocations
+    bool countingAllocations();
+
+    // Number of calls to the global operator new so far (all threads)
+    size_t heapAllocations();
+}
+}
+
+#endif // ALLOCATION_COUNTER_H
@@ -0,0 +1,126 @@
+//
+//  batch_prefetcher.cpp
+//  NeuralNetwork
+//
+#include <algorithm>
+#include "batch_prefetcher.h"
+
+namespace NeuralNetwork{
+    BatchPrefetcher::BatchPrefetcher(size_t batchSize, size_t slices, size_t classes)
+    : batchSize(std::max<size_t>(batchSize, 1)),
+      slices(std::max<size_t>(slices, 1)),
+      classes(classes)
+    {
+        for (Batch& batch : batches) {
+            batch.inputs.resize(this->slices, Matrix<float>(0, 0));
+            batch.targets.resize(this->slices, Matrix<float>(0, 0));
+        }
+        worker = std::thread(&BatchPrefetcher::workerLoop, this);
+    }
+
+    BatchPrefetcher::~BatchPrefetcher() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+    }
+
+    void BatchPrefetcher::stack(const DatasetView& rows, Matrix<float>& inputs, Matrix<float>& targets, size_t classes) {
+        inputs.resize(rows.size(), rows.features);
+        targets.resize(rows.size(), classes);
+        std::fill(targets.begin(), targets.end(), 0.1f);
+        for (size_t b = 0; b < rows.size(); ++b) {
+            rows.copyRow(b, inputs.values() + b * rows.features);
+            targets(b, rows.label(b)) = 0.99f; // One-hot encoding
+        }
+    }
+
+    // Queue the next batch of the pass into a buffer; called with the mutex held
+    void BatchPrefetcher::request(size_t buffer) {
+        if (nextFirst >= rows.size()) {
+            states[buffer] = State::Idle;
+            return;
+        }
+        Batch& batch = batches[buffer];
+        batch.error = nullptr;
+        batch.first = nextFirst;
+        batch.count = std::min(batchSize, rows.size() - nextFirst);
+        batch.slices = std::min(slices, batch.count);
+        nextFirst += batch.count;
+        states[buffer] = State::Requested;
+    }
+
+    void BatchPrefetcher::start(const DatasetView& rows) {
+        std::unique_lock<std::mutex> lock(mutex);
+        // A pass abandoned half way may still have a batch being filled from the old rows
+        changed.wait(lock, [this] { return states[0] != State::Requested && states[1] != State::Requested; });
+        this->rows = rows;
+        nextFirst = 0;
+        nextBatch = 0;
+        request(0);
+        request(1);
+        lock.unlock();
+        changed.notify_all();
+    }
+
+    BatchPrefetcher::Batch* BatchPrefetcher::acquire() {
+        std::unique_lock<std::mutex> lock(mutex);
+        size_t buffer = nextBatch;
+        changed.wait(lock, [this, buffer] { return states[buffer] != State::Requested; });
+        if (states[buffer] == State::Idle) {
+            return nullptr;
+        }
+        if (batches[buffer].error) {
+            // Nothing after the failed batch is handed out: end the pass here
+            std::exception_ptr error = batches[buffer].error;
+            nextFirst = rows.size();
+            states[buffer] = State::Idle;
+            lock.unlock();
+            changed.notify_all();
+            std::rethrow_exception(error);
+        }
+        nextBatch = 1 - buffer;
+        return &batches[buffer];
+    }
+
+    void BatchPrefetcher::release(Batch* batch) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            request(static_cast<size_t>(batch - batches));
+        }
+        changed.notify_all();
+    }
+
+    void BatchPrefetcher::fill(Batch& batch) {
+        for (size_t p = 0; p < batch.slices; ++p) {
+            size_t begin = sliceStart(batch.first, batch.count, batch.slices, p);
+            size_t end = sliceStart(batch.first, batch.count, batch.slices, p + 1);
+            stack(rows.slice(begin, end - begin), batch.inputs[p], batch.targets[p], classes);
+        }
+    }
+
+    // Fill requested buffers in the order they were requested
+    void BatchPrefetcher::workerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, [this] { return stopping || states[0] == State::Requested || states[1] == State::Requested; });
+            if (stopping) {
+                return;
+            }
+            size_t buffer = (states[nextBatch] == State::Requested) ? nextBatch : 1 - nextBatch;
+            lock.unlock();
+            // A failure is handed to the training thread with the batch, as DataStream does
+            // with its reader's errors
+            try {
+                fill(batches[buffer]);
+            } catch (...) {
+                batches[buffer].error = std::current_exception();
+            }
+            lock.lock();
+            states[buffer] = State::Ready;
+            changed.notify_all();
+        }
+    }
+}
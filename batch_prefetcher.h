@@ -0,0 +1,88 @@
+//
+//  batch_prefetcher.h
+//  NeuralNetwork
+//
+//  Mini-batches assembled on a background thread, one batch ahead of training. There are two
+//  batch buffers: while the compute threads work on batch k, batch k + 1 is gathered from the
+//  dataset, converted to float and given its one-hot targets in the other buffer, so none of
+//  that is on the training critical path.
+//
+//  A batch is split into the same even slices the data-parallel step hands its workers, each
+//  slice stacked as its own pair of matrices. Training takes a batch by swapping those
+//  matrices with its workspace's - no copy - and hands it back with the workspace's old
+//  matrices in it, to be refilled with the batch after next.
+//
+#ifndef BATCH_PREFETCHER_H
+#define BATCH_PREFETCHER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "dataset.h"
+#include "matrix.h"
+
+namespace NeuralNetwork{
+    class BatchPrefetcher {
+    public:
+        struct Batch {
+            std::vector<Matrix<float>> inputs;  // slice p: rows x features
+            std::vector<Matrix<float>> targets; // slice p: rows x classes
+            size_t first = 0;
+            size_t count = 0;
+            size_t slices = 0; // slices in use: min(slice count, count)
+            std::exception_ptr error; // what filling the batch threw, rethrown by acquire()
+        };
+
+        // Batches of batchSize rows, each split into `slices` slices, with one-hot targets over
+        // `classes` outputs
+        BatchPrefetcher(size_t batchSize, size_t slices, size_t classes);
+        ~BatchPrefetcher();
+
+        BatchPrefetcher(const BatchPrefetcher&) = delete;
+        BatchPrefetcher& operator=(const BatchPrefetcher&) = delete;
+
+        // Start assembling the batches of one pass over rows, in order. rows must stay valid
+        // until every batch of the pass has been acquired.
+        void start(const DatasetView& rows);
+
+        // The next batch of the pass, waiting until it is ready; nullptr after the last one.
+        // Swap its matrices out, then release() it. Rethrows what assembling the batch threw
+        // (a label outside the classes); the pass is over then and must be started again.
+        Batch* acquire();
+        void release(Batch* batch);
+
+        // First row of slice p when count rows starting at first are split over `slices`
+        static size_t sliceStart(size_t first, size_t count, size_t slices, size_t p) {
+            return first + p * count / slices;
+        }
+
+        // Stack rows as the rows of inputs, converted to float, with one-hot targets (0.99 for
+        // the label, 0.1 elsewhere)
+        static void stack(const DatasetView& rows, Matrix<float>& inputs, Matrix<float>& targets, size_t classes);
+
+    private:
+        enum class State { Idle, Requested, Ready };
+
+        size_t batchSize;
+        size_t slices;
+        size_t classes;
+        DatasetView rows;
+        Batch batches[2];
+        State states[2] = {State::Idle, State::Idle};
+        size_t nextFirst = 0;  // first row of the next batch to request
+        size_t nextBatch = 0;  // buffer holding the next batch to acquire
+        bool stopping = false;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::thread worker;
+
+        void request(size_t buffer);
+        void workerLoop();
+        void fill(Batch& batch);
+    };
+}
+
+#endif // BATCH_PREFETCHER_H
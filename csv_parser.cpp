@@ -0,0 +1,294 @@
+//
+//  csv_parser.cpp
+//  NeuralNetwork
+//
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "csv_parser.h"
+#include "mapped_file.h"
+#include "thread_pool.h"
+
+namespace NeuralNetwork{
+namespace Csv {
+namespace {
+    // Chunks handed to each thread; small buffers stay in one piece. Mapped files are also
+    // cut into chunks of at most maximumChunkBytes so that each can be released when done.
+    constexpr size_t chunksPerThread = 4;
+    constexpr size_t minimumChunkBytes = 1 << 16;
+    constexpr size_t maximumChunkBytes = 1 << 23;
+
+    struct Chunk {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        size_t firstRow = 0;
+        size_t rows = 0;
+        std::exception_ptr error;
+    };
+
+    [[noreturn]] void fail(size_t row, const char* what) {
+        throw std::runtime_error("CSV row " + std::to_string(row) + ": " + what);
+    }
+
+    const char* skipBlankLines(const char* p, const char* end) {
+        while (p < end && (*p == '\n' || *p == '\r')) {
+            ++p;
+        }
+        return p;
+    }
+
+    const char* lineEnd(const char* p, const char* end) {
+        const void* newline = std::memchr(p, '\n', end - p);
+        return newline ? static_cast<const char*>(newline) : end;
+    }
+
+    bool endsField(const char* p, const char* end) {
+        return p == end || *p == ',' || *p == '\r' || *p == '\n';
+    }
+
+    // Plain unsigned integers of up to 9 digits - the common case for pixel data - are read
+    // inline; returns p unchanged when the field is anything else (sign, fraction, exponent)
+    const char* parseSmallInteger(const char* p, const char* end, unsigned& value) {
+        if constexpr (std::endian::native == std::endian::little) {
+            // One to three digits without a data-dependent branch per digit: load four bytes,
+            // find the first non-digit, and combine the digits with two multiplies
+            if (end - p >= 4) {
+                uint32_t word;
+                std::memcpy(&word, p, sizeof(word));
+                uint32_t digits = word - 0x30303030u;
+                // High bit set in every byte that is not '0'..'9'; borrows and carries only
+                // move towards later bytes, so the first flagged byte is exact
+                uint32_t nonDigits = (digits | (digits + 0x76767676u)) & 0x80808080u;
+                int length = std::countr_zero(nonDigits) / 8;
+                if (length > 0 && length < 4 && endsField(p + length, end)) {
+                    uint32_t x = digits << (8 * (4 - length)); // right-align, leading zeros
+                    x = ((x & 0x0F0F0F0Fu) * 2561u) >> 8;
+                    x = ((x & 0x00FF00FFu) * 6553601u) >> 16;
+                    value = x & 0xFFFFu;
+                    return p + length;
+                }
+            }
+        }
+
+        const char* q = p;
+        unsigned v = 0;
+        while (q < end && q - p < 10 && static_cast<unsigned>(*q - '0') < 10) {
+            v = v * 10 + static_cast<unsigned>(*q - '0');
+            ++q;
+        }
+        if (q == p || q - p > 9 || !endsField(q, end)) {
+            return p;
+        }
+        value = v;
+        return q;
+    }
+
+    // Parse one row starting at p; returns the position of its terminating '\n' (or end)
+    template <typename T>
+    const char* parseRow(const char* p, const char* end, T* out, size_t features, float scalingFactor, int& label, size_t row) {
+        auto [afterLabel, labelError] = std::from_chars(p, end, label);
+        if (labelError != std::errc()) {
+            fail(row, "malformed label");
+        }
+        p = afterLabel;
+
+        for (size_t j = 0; j < features; ++j) {
+            if (p == end || *p != ',') {
+                fail(row, (p == end || *p == '\n' || *p == '\r') ? "too few values" : "malformed value");
+            }
+            ++p;
+            unsigned integer;
+            const char* next = parseSmallInteger(p, end, integer);
+            if constexpr (std::is_same_v<T, float>) {
+                if (next != p) {
+                    out[j] = static_cast<float>(integer) / scalingFactor;
+                    p = next;
+                    continue;
+                }
+                float value;
+                auto [afterValue, error] = std::from_chars(p, end, value);
+                if (error != std::errc()) {
+                    fail(row, "malformed value");
+                }
+                out[j] = value / scalingFactor;
+                p = afterValue;
+            } else {
+                if (next != p && integer <= std::numeric_limits<T>::max()) {
+                    out[j] = static_cast<T>(integer);
+                    p = next;
+                    continue;
+                }
+                unsigned value;
+                auto [afterValue, error] = std::from_chars(p, end, value);
+                if (error != std::errc()) {
+                    fail(row, "malformed value");
+                }
+                if (value > std::numeric_limits<T>::max()) {
+                    fail(row, "value does not fit the feature type");
+                }
+                out[j] = static_cast<T>(value);
+                p = afterValue;
+            }
+        }
+
+        if (p < end && *p == '\r') {
+            ++p;
+        }
+        if (p < end && *p != '\n') {
+            fail(row, (*p == ',') ? "too many values" : "malformed value");
+        }
+        return p;
+    }
+
+    template <typename T>
+    size_t parseRows(const char* p, const char* end, Dataset& dataset, size_t firstRow, float scalingFactor, size_t maxRows) {
+        size_t features = dataset.getFeatures();
+        size_t parsed = 0;
+        p = skipBlankLines(p, end);
+        while (p < end && (maxRows == 0 || parsed < maxRows)) {
+            size_t row = firstRow + parsed;
+            if (row >= dataset.getRows()) {
+                throw std::runtime_error("CSV has more rows than the dataset was sized for");
+            }
+            p = parseRow(p, end, dataset.row<T>(row), features, scalingFactor, dataset.label(row), row);
+            ++parsed;
+            p = skipBlankLines(p, end);
+        }
+        return parsed;
+    }
+}
+
+    Shape measure(const char* begin, const char* end, size_t maxRows) {
+        Shape shape;
+        const char* p = skipBlankLines(begin, end);
+        if (p < end) {
+            shape.features = std::count(p, lineEnd(p, end), ',');
+        }
+        while (p < end && (maxRows == 0 || shape.rows < maxRows)) {
+            ++shape.rows;
+            p = skipBlankLines(lineEnd(p, end), end);
+        }
+        shape.next = p;
+        return shape;
+    }
+
+    size_t parse(const char* begin, const char* end, Dataset& dataset, size_t firstRow, float scalingFactor, size_t maxRows) {
+        switch (dataset.getType()) {
+            case FeatureType::UInt8:
+                return parseRows<uint8_t>(begin, end, dataset, firstRow, scalingFactor, maxRows);
+            case FeatureType::UInt16:
+                return parseRows<uint16_t>(begin, end, dataset, firstRow, scalingFactor, maxRows);
+            default:
+                return parseRows<float>(begin, end, dataset, firstRow, scalingFactor, maxRows);
+        }
+    }
+
+namespace {
+    Dataset loadChunks(const char* begin, const char* end, FeatureType type, float scalingFactor, size_t maxRows, ThreadPool* pool, const MappedFile* source, size_t* bytesUsed) {
+        const char* firstLine = skipBlankLines(begin, end);
+        size_t features = (firstLine < end) ? std::count(firstLine, lineEnd(firstLine, end), ',') : 0;
+
+        // Cut the buffer into chunks that each start at the beginning of a line
+        size_t threads = pool ? pool->size() : 1;
+        size_t bytes = static_cast<size_t>(end - begin);
+        size_t chunkCount = (threads == 1) ? 1 : threads * chunksPerThread;
+        if (source && source->isMapped()) {
+            chunkCount = std::max(chunkCount, (bytes + maximumChunkBytes - 1) / maximumChunkBytes);
+        }
+        chunkCount = std::min(chunkCount, bytes / minimumChunkBytes + 1);
+        std::vector<Chunk> chunks(chunkCount);
+        const char* cursor = begin;
+        for (size_t c = 0; c < chunkCount; ++c) {
+            chunks[c].begin = cursor;
+            const char* cut = (c + 1 == chunkCount) ? end : std::max(cursor, begin + (end - begin) * (c + 1) / chunkCount);
+            const char* newline = lineEnd(cut, end);
+            cursor = (cut == end || newline == end) ? end : newline + 1;
+            chunks[c].end = cursor;
+        }
+
+        // Runs work over chunks [first, last)
+        auto runChunks = [&](size_t first, size_t last, auto work) {
+            auto task = [&](size_t i) {
+                Chunk& chunk = chunks[first + i];
+                try {
+                    work(chunk);
+                    if (source) {
+                        source->release(chunk.begin, chunk.end);
+                    }
+                } catch (...) {
+                    chunk.error = std::current_exception();
+                }
+            };
+            if (pool) {
+                pool->run(last - first, task);
+            } else {
+                for (size_t i = 0; i < last - first; ++i) {
+                    task(i);
+                }
+            }
+            for (size_t c = first; c < last; ++c) {
+                if (chunks[c].error) {
+                    std::rethrow_exception(chunks[c].error);
+                }
+            }
+        };
+
+        // Pass 1: rows per chunk; a prefix sum places each chunk, capped at maxRows overall.
+        // Under a cap the chunks are counted a wave of one per thread at a time, in file
+        // order, and nothing after the wave that reaches the cap is read.
+        size_t rows = 0;
+        size_t used = 0;
+        while (used < chunkCount && (maxRows == 0 || rows < maxRows)) {
+            size_t wave = (maxRows == 0) ? chunkCount : std::min(chunkCount, used + threads);
+            runChunks(used, wave, [](Chunk& chunk) { chunk.rows = measure(chunk.begin, chunk.end).rows; });
+            for (; used < wave; ++used) {
+                Chunk& chunk = chunks[used];
+                chunk.firstRow = rows;
+                if (maxRows > 0) {
+                    chunk.rows = std::min(chunk.rows, maxRows - rows);
+                }
+                rows += chunk.rows;
+            }
+        }
+        while (used > 0 && chunks[used - 1].rows == 0) {
+            --used;
+        }
+
+        // The text the rows come from ends inside the last chunk when the cap cut it short
+        if (bytesUsed) {
+            const char* last = begin;
+            if (used > 0) {
+                const Chunk& chunk = chunks[used - 1];
+                last = (maxRows > 0 && rows == maxRows) ? measure(chunk.begin, chunk.end, chunk.rows).next : chunk.end;
+            }
+            *bytesUsed = static_cast<size_t>(last - begin);
+        }
+
+        // Pass 2: parse every chunk in place into its own rows
+        float scale = (type == FeatureType::Float32) ? 1.0f : 1.0f / scalingFactor;
+        Dataset dataset(rows, features, type, scale);
+        runChunks(0, used, [&](Chunk& chunk) {
+            if (chunk.rows > 0) {
+                parse(chunk.begin, chunk.end, dataset, chunk.firstRow, scalingFactor, chunk.rows);
+            }
+        });
+        return dataset;
+    }
+}
+
+    Dataset load(const char* begin, const char* end, FeatureType type, float scalingFactor, size_t maxRows, ThreadPool* pool, size_t* bytesUsed) {
+        return loadChunks(begin, end, type, scalingFactor, maxRows, pool, nullptr, bytesUsed);
+    }
+
+    Dataset load(const MappedFile& file, FeatureType type, float scalingFactor, size_t maxRows, ThreadPool* pool, size_t* bytesUsed) {
+        return loadChunks(file.begin(), file.end(), type, scalingFactor, maxRows, pool, &file, bytesUsed);
+    }
+}
+}
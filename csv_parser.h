@@ -0,0 +1,55 @@
+//
+//  csv_parser.h
+//  NeuralNetwork
+//
+//  CSV parsing straight from an in-memory buffer into a Dataset. Each non-empty line is a
+//  label followed by the features, comma separated; "\n" and "\r\n" line endings are both
+//  accepted. Numbers are read with std::from_chars directly out of the buffer - no lines or
+//  fields are copied, and nothing is allocated per row.
+//
+//  load() spreads the work over a thread pool. The buffer is cut at line boundaries into
+//  chunks, the rows of every chunk are counted in parallel, a prefix sum over the counts
+//  gives each chunk its first row, and the chunks are then parsed in parallel straight into
+//  their own rows of one dataset. Every row is written once, in file order.
+//
+//  Loading from a MappedFile releases every chunk of the mapping as soon as a pass is done
+//  with it, so the text and the parsed dataset are never both fully resident.
+//
+#ifndef CSV_PARSER_H
+#define CSV_PARSER_H
+
+#include <cstddef>
+#include "dataset.h"
+
+namespace NeuralNetwork{
+class ThreadPool;
+class MappedFile;
+
+namespace Csv {
+    // Number of rows (non-empty lines, at most maxRows when maxRows > 0), the number of
+    // features on the first row, and where the text after the counted rows starts
+    struct Shape {
+        size_t rows = 0;
+        size_t features = 0;
+        const char* next = nullptr;
+    };
+    Shape measure(const char* begin, const char* end, size_t maxRows = 0);
+
+    // Parse the rows in [begin, end) into dataset rows firstRow, firstRow + 1, ..., stopping
+    // after maxRows rows when maxRows > 0. Float features are divided by scalingFactor;
+    // uint8/uint16 features must be integers that fit the type and are stored as is.
+    // Returns the number of rows parsed; throws std::runtime_error on malformed input.
+    size_t parse(const char* begin, const char* end, Dataset& dataset, size_t firstRow, float scalingFactor, size_t maxRows = 0);
+
+    // Measure and parse the whole buffer into a new dataset of the given feature type, at most
+    // maxRows rows when maxRows > 0. Float features are stored divided by scalingFactor, and
+    // compact ones carry 1 / scalingFactor as their scale. pool may be null (one thread).
+    // The error for the earliest bad row is the one thrown. Under a row cap the text after
+    // the capped rows is mostly never read; bytesUsed, when given, is set to the length of
+    // the text the rows were parsed from.
+    Dataset load(const char* begin, const char* end, FeatureType type, float scalingFactor, size_t maxRows, ThreadPool* pool, size_t* bytesUsed = nullptr);
+    Dataset load(const MappedFile& file, FeatureType type, float scalingFactor, size_t maxRows, ThreadPool* pool, size_t* bytesUsed = nullptr);
+}
+}
+
+#endif // CSV_PARSER_H
@@ -0,0 +1,194 @@
+//
+//  data_stream.cpp
+//  NeuralNetwork
+//
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include "csv_parser.h"
+#include "data_stream.h"
+
+namespace NeuralNetwork{
+    namespace {
+        // Text is read this many bytes at a time
+        constexpr size_t readBlock = 1 << 20;
+
+        void copyRow(const Dataset& from, size_t i, Dataset& to, size_t j) {
+            std::memcpy(to.row<unsigned char>(j), from.row<unsigned char>(i), from.getStride());
+            to.label(j) = from.label(i);
+        }
+    }
+
+    DataStream::DataStream(const std::string& path, size_t features, size_t classes, FeatureType type, float scalingFactor, size_t shardRows, size_t ringShards, size_t shuffleRows, size_t maxRows, uint64_t seed)
+    : path(path),
+      classes(classes),
+      scalingFactor(scalingFactor),
+      shardRows(std::max<size_t>(shardRows, 1)),
+      maxRows(maxRows),
+      shardSizes(std::max<size_t>(ringShards, 1), 0),
+      gen(seed)
+    {
+        // Same storage as Csv::load: float features scaled as they are parsed, compact ones
+        // carrying the scale
+        float scale = (type == FeatureType::Float32) ? 1.0f : 1.0f / scalingFactor;
+        for (size_t s = 0; s < shardSizes.size(); ++s) {
+            shards.emplace_back(this->shardRows, features, type, scale);
+        }
+        buffer = Dataset(std::max<size_t>(shuffleRows, 1), features, type, scale);
+        chunk = Dataset(this->shardRows, features, type, scale);
+        reader = std::thread(&DataStream::readerLoop, this);
+    }
+
+    DataStream::~DataStream() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        reader.join();
+    }
+
+    size_t DataStream::bufferBytes() const {
+        return shards.size() * shards[0].featureBytes() + buffer.featureBytes() + chunk.featureBytes();
+    }
+
+    // Parse the file shard by shard into the ring. The text buffer holds the unparsed tail of
+    // what has been read; it grows only until it holds one shard's worth of lines.
+    void DataStream::readerLoop() {
+        try {
+            std::ifstream file(path, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Failed to open data file: " + path);
+            }
+            std::string text;
+            size_t begin = 0;
+            bool endOfFile = false;
+            size_t rowsRead = 0;
+
+            while (maxRows == 0 || rowsRead < maxRows) {
+                size_t wanted = (maxRows == 0) ? shardRows : std::min(shardRows, maxRows - rowsRead);
+                // Only whole lines are measured until the file has been read to the end
+                const char* start = text.data() + begin;
+                const char* complete = text.data() + text.size();
+                if (!endOfFile) {
+                    while (complete > start && complete[-1] != '\n') {
+                        --complete;
+                    }
+                }
+                Csv::Shape shape = Csv::measure(start, complete, wanted);
+
+                if (shape.rows < wanted && !endOfFile) {
+                    text.erase(0, begin);
+                    begin = 0;
+                    size_t used = text.size();
+                    text.resize(used + readBlock);
+                    file.read(text.data() + used, readBlock);
+                    text.resize(used + static_cast<size_t>(file.gcount()));
+                    if (file.bad()) {
+                        throw std::runtime_error("Failed to read data file: " + path);
+                    }
+                    endOfFile = file.gcount() == 0;
+                    continue;
+                }
+                if (shape.rows == 0) {
+                    break;
+                }
+
+                // Wait for a free shard, fill it, and hand it over
+                size_t slot;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [this] { return stopping || filled < shards.size(); });
+                    if (stopping) {
+                        return;
+                    }
+                    slot = (head + filled) % shards.size();
+                }
+                try {
+                    Csv::parse(start, shape.next, shards[slot], 0, scalingFactor, shape.rows);
+                } catch (const std::runtime_error& e) {
+                    throw std::runtime_error("In the shard starting at row " + std::to_string(rowsRead) + ": " + e.what());
+                }
+                // Every label has to name an output, as loadData checks for data held in memory
+                for (size_t i = 0; i < shape.rows; ++i) {
+                    int label = shards[slot].label(i);
+                    if (label < 0 || static_cast<size_t>(label) >= classes) {
+                        throw std::runtime_error("Row " + std::to_string(rowsRead + i) + " of " + path + " has label " + std::to_string(label)
+                                                 + "; labels must be 0 to " + std::to_string(classes - 1));
+                    }
+                }
+                shardSizes[slot] = shape.rows;
+                rowsRead += shape.rows;
+                begin = shape.next - text.data();
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    ++filled;
+                }
+                changed.notify_all();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        changed.notify_all();
+    }
+
+    // Copy the next row of the file into the shuffle buffer's row `slot`; false at the end
+    bool DataStream::takeRow(size_t slot) {
+        if (!holdingShard) {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return filled > 0 || finished; });
+            if (filled == 0) {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                return false;
+            }
+            holdingShard = true;
+            cursor = 0;
+        }
+
+        copyRow(shards[head], cursor, buffer, slot);
+        if (++cursor == shardSizes[head]) {
+            // Done with this shard: give it back to the reader
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                head = (head + 1) % shards.size();
+                --filled;
+            }
+            holdingShard = false;
+            changed.notify_all();
+        }
+        return true;
+    }
+
+    DatasetView DataStream::next(size_t rows) {
+        if (!primed) {
+            while (buffered < buffer.getRows() && takeRow(buffered)) {
+                ++buffered;
+            }
+            primed = true;
+        }
+
+        // Hand out a random buffered row and refill its place with the next row of the file;
+        // once the file is exhausted the buffer drains
+        rows = std::min(rows, chunk.getRows());
+        size_t produced = 0;
+        while (produced < rows && buffered > 0) {
+            size_t pick = std::uniform_int_distribution<size_t>(0, buffered - 1)(gen);
+            copyRow(buffer, pick, chunk, produced++);
+            if (!takeRow(pick)) {
+                --buffered;
+                if (pick != buffered) {
+                    copyRow(buffer, buffered, buffer, pick);
+                }
+            }
+        }
+        return chunk.view(0, produced);
+    }
+}
@@ -0,0 +1,85 @@
+//
+//  data_stream.h
+//  NeuralNetwork
+//
+//  One pass over a CSV data file that is too large to hold in memory. A reader thread reads
+//  the file in order and parses it a shard (a fixed number of rows) at a time into a
+//  bounded ring of shard buffers, running ahead of training until the ring is full. The
+//  training side takes rows out through a shuffle buffer: the buffer is filled with the
+//  first rows, and every row handed out is picked at random from it and replaced by the
+//  next row read, which shuffles the file approximately - across a window the size of the
+//  buffer rather than the whole file.
+//
+//  Memory is fixed when the stream is created: the ring, the shuffle buffer, one chunk of
+//  output rows and the text of about one shard, whatever the size of the file.
+//
+#ifndef DATA_STREAM_H
+#define DATA_STREAM_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dataset.h"
+#include "random.h"
+
+namespace NeuralNetwork{
+    class DataStream {
+        // Reader side
+        std::string path;
+        size_t classes;
+        float scalingFactor;
+        size_t shardRows;
+        size_t maxRows;
+        std::thread reader;
+
+        // The ring: shards[head] .. shards[head + filled - 1] (mod size) are ready to be read;
+        // guarded by mutex
+        std::vector<Dataset> shards;
+        std::vector<size_t> shardSizes;
+        size_t head = 0;
+        size_t filled = 0;
+        bool finished = false;
+        bool stopping = false;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable changed;
+
+        // Consumer side
+        Dataset buffer; // the shuffle buffer
+        size_t buffered = 0;
+        bool primed = false;
+        bool holdingShard = false;
+        size_t cursor = 0; // next row of shards[head] while holdingShard
+        Dataset chunk;
+        Xoshiro256 gen;
+
+        void readerLoop();
+        bool takeRow(size_t slot);
+
+    public:
+        // Rows of `features` values stored as `type`, labelled 0 .. classes - 1, read shardRows
+        // at a time into a ring of ringShards shards; at most maxRows rows when maxRows > 0.
+        // The reader starts at once.
+        DataStream(const std::string& path, size_t features, size_t classes, FeatureType type, float scalingFactor, size_t shardRows, size_t ringShards, size_t shuffleRows, size_t maxRows, uint64_t seed);
+        ~DataStream();
+
+        DataStream(const DataStream&) = delete;
+        DataStream& operator=(const DataStream&) = delete;
+
+        // The next up-to-`rows` rows in shuffled order (at most shardRows); empty once the
+        // file is exhausted. The view is valid until the next call. Rethrows the reader's
+        // error (a missing file, a malformed row, a label outside the classes) when it hits one.
+        DatasetView next(size_t rows);
+
+        // Bytes held in shard, shuffle and output buffers
+        size_t bufferBytes() const;
+    };
+}
+
+#endif // DATA_STREAM_H
@@ -0,0 +1,139 @@
+//
+//  dataset.cpp
+//  NeuralNetwork
+//
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include "dataset.h"
+
+namespace NeuralNetwork{
+    namespace {
+        constexpr size_t cacheLine = 64;
+
+        // Plain widening loops; the compiler vectorises the conversion and the scale
+        template <typename T>
+        void convertRow(const T* in, float scale, float* out, size_t n) {
+            for (size_t j = 0; j < n; ++j) {
+                out[j] = static_cast<float>(in[j]) * scale;
+            }
+        }
+    }
+
+    size_t featureSize(FeatureType type) {
+        switch (type) {
+            case FeatureType::UInt8:
+                return sizeof(uint8_t);
+            case FeatureType::UInt16:
+                return sizeof(uint16_t);
+            default:
+                return sizeof(float);
+        }
+    }
+
+    FeatureType featureTypeFromName(const std::string& name) {
+        if (name == "float32") {
+            return FeatureType::Float32;
+        }
+        if (name == "uint8") {
+            return FeatureType::UInt8;
+        }
+        if (name == "uint16") {
+            return FeatureType::UInt16;
+        }
+        throw std::invalid_argument("Unknown feature type: " + name);
+    }
+
+    const char* featureTypeName(FeatureType type) {
+        switch (type) {
+            case FeatureType::UInt8:
+                return "uint8";
+            case FeatureType::UInt16:
+                return "uint16";
+            default:
+                return "float32";
+        }
+    }
+
+    DataFormat dataFormatFromName(const std::string& name) {
+        if (name == "csv") {
+            return DataFormat::Csv;
+        }
+        if (name == "idx") {
+            return DataFormat::Idx;
+        }
+        throw std::invalid_argument("Unknown data format: " + name);
+    }
+
+    const char* dataFormatName(DataFormat format) {
+        return (format == DataFormat::Idx) ? "idx" : "csv";
+    }
+
+    void DatasetView::copyRow(size_t i, float* out) const {
+        const unsigned char* bytes = row(i);
+        switch (type) {
+            case FeatureType::UInt8:
+                convertRow(reinterpret_cast<const uint8_t*>(bytes), scale, out, features);
+                break;
+            case FeatureType::UInt16:
+                convertRow(reinterpret_cast<const uint16_t*>(bytes), scale, out, features);
+                break;
+            default:
+                convertRow(reinterpret_cast<const float*>(bytes), scale, out, features);
+                break;
+        }
+    }
+
+    Dataset::Dataset(size_t rows, size_t features, FeatureType type, float scale)
+    : labels(rows, 0),
+      rows(rows),
+      features(features),
+      stride((features * featureSize(type) + cacheLine - 1) / cacheLine * cacheLine),
+      type(type),
+      scale(scale)
+    {
+        // The byte count is a multiple of the alignment, as aligned_alloc requires
+        size_t bytes = std::max(rows * stride, cacheLine);
+        writable = static_cast<unsigned char*>(std::aligned_alloc(cacheLine, bytes));
+        if (!writable) {
+            throw std::bad_alloc();
+        }
+        owner = std::shared_ptr<void>(writable, [](void* p) { std::free(p); });
+        storage = writable;
+        std::fill(writable, writable + bytes, static_cast<unsigned char>(0));
+    }
+
+    Dataset::Dataset(std::shared_ptr<void> owner, const unsigned char* storage, std::vector<int> labels, size_t features, size_t stride, FeatureType type, float scale)
+    : owner(std::move(owner)),
+      storage(storage),
+      labels(std::move(labels)),
+      rows(this->labels.size()),
+      features(features),
+      stride(stride),
+      type(type),
+      scale(scale)
+    {
+        if (stride < features * featureSize(type)) {
+            throw std::invalid_argument("Dataset stride is shorter than a row");
+        }
+    }
+
+    void Dataset::truncate(size_t count) {
+        if (count < rows) {
+            rows = count;
+            labels.resize(count);
+        }
+    }
+
+    DatasetView Dataset::view(size_t first, size_t count) const {
+        if (first > rows || count > rows - first) {
+            throw std::out_of_range("Dataset::view: rows out of range");
+        }
+        return {storage + first * stride, labels.data() + first, count, features, stride, type, scale, nullptr};
+    }
+
+    DatasetView Dataset::view(std::span<const size_t> order) const {
+        return {storage, labels.data(), order.size(), features, stride, type, scale, order.data()};
+    }
+}
@@ -0,0 +1,148 @@
+//
+//  dataset.h
+//  NeuralNetwork
+//
+//  Every sample of a dataset in one row-major block, with the labels in a parallel array.
+//  Rows a dataset allocates itself are padded out to a whole number of cache lines (the
+//  stride), so each of those samples starts on a 64-byte boundary. Samples and batches are
+//  handed out as borrowed views.
+//  A view either covers a contiguous run of rows or follows a list of row indices, so
+//  shuffling and splitting permute indices and never move the rows themselves.
+//
+//  Features are stored as float, or compactly as uint8/uint16 with a per-dataset scale
+//  (4x / 2x less memory and bandwidth for pixel-style data). Compact rows are converted to
+//  float only when they are fed to the network; float rows are read in place.
+//
+//  The feature block is normally allocated by the dataset, but a dataset can also adopt one
+//  that lives elsewhere - a memory-mapped cache file, say - and keep its owner alive. Adopted
+//  rows are read-only and keep the layout they have there, which need not be aligned or
+//  padded: IDX images are packed back to back (stride 784 for MNIST) from file offset 16.
+//
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace NeuralNetwork{
+    enum class FeatureType { Float32, UInt8, UInt16 };
+
+    // Bytes per stored feature
+    size_t featureSize(FeatureType type);
+    // "float32", "uint8" or "uint16"; throws std::invalid_argument for anything else
+    FeatureType featureTypeFromName(const std::string& name);
+    const char* featureTypeName(FeatureType type);
+
+    // How a data file is laid out on disk: CSV text, or MNIST's binary IDX tensors
+    enum class DataFormat { Csv, Idx };
+
+    // "csv" or "idx"; throws std::invalid_argument for anything else
+    DataFormat dataFormatFromName(const std::string& name);
+    const char* dataFormatName(DataFormat format);
+
+    // Rows of a Dataset: a contiguous run, or the rows listed in `order`. Borrowed: valid while
+    // the dataset (and the order) is alive and not reloaded.
+    struct DatasetView {
+        const unsigned char* data = nullptr;
+        const int* labels = nullptr;
+        size_t rows = 0;
+        size_t features = 0;
+        size_t stride = 0; // bytes between rows
+        FeatureType type = FeatureType::Float32;
+        float scale = 1.0f; // feature value = stored value * scale
+        const size_t* order = nullptr; // when set, row i of the view is row order[i] of data
+
+        size_t size() const { return rows; }
+        bool empty() const { return rows == 0; }
+        size_t rowIndex(size_t i) const { return order ? order[i] : i; }
+        const unsigned char* row(size_t i) const { return data + rowIndex(i) * stride; }
+        int label(size_t i) const { return labels[rowIndex(i)]; }
+
+        // Convert row i to scaled floats in out (features entries)
+        void copyRow(size_t i, float* out) const;
+
+        // Row i as floats: in place for float storage (scale 1), otherwise converted into
+        // scratch, which must hold `features` floats
+        std::span<const float> sample(size_t i, float* scratch) const {
+            if (type == FeatureType::Float32 && scale == 1.0f) {
+                return {reinterpret_cast<const float*>(row(i)), features};
+            }
+            copyRow(i, scratch);
+            return {scratch, features};
+        }
+
+        // Rows [first, first + count) of this view
+        DatasetView slice(size_t first, size_t count) const {
+            if (order) {
+                return {data, labels, count, features, stride, type, scale, order + first};
+            }
+            return {data + first * stride, labels + first, count, features, stride, type, scale, nullptr};
+        }
+    };
+
+    class Dataset {
+        std::shared_ptr<void> owner; // keeps storage alive: an aligned allocation or a mapping
+        const unsigned char* storage = nullptr;
+        unsigned char* writable = nullptr; // storage when the dataset allocated it; adopted rows are read-only
+        std::vector<int> labels;
+        size_t rows = 0;
+        size_t features = 0;
+        size_t stride = 0;
+        FeatureType type = FeatureType::Float32;
+        float scale = 1.0f;
+
+    public:
+        Dataset() = default;
+        // rows x features of the given type, zero-filled (padding included)
+        Dataset(size_t rows, size_t features, FeatureType type = FeatureType::Float32, float scale = 1.0f);
+        // Adopt labels.size() read-only rows starting at storage, each stride bytes apart. owner
+        // is kept until the dataset is destroyed.
+        Dataset(std::shared_ptr<void> owner, const unsigned char* storage, std::vector<int> labels, size_t features, size_t stride, FeatureType type, float scale);
+
+        Dataset(const Dataset&) = delete;
+        Dataset& operator=(const Dataset&) = delete;
+        Dataset(Dataset&&) = default;
+        Dataset& operator=(Dataset&&) = default;
+
+        size_t getRows() const { return rows; }
+        size_t getFeatures() const { return features; }
+        size_t getStride() const { return stride; }
+        FeatureType getType() const { return type; }
+        float getScale() const { return scale; }
+        // Bytes held by the feature block
+        size_t featureBytes() const { return rows * stride; }
+        // The feature block (featureBytes() bytes) and the labels (getRows() entries)
+        const unsigned char* featureData() const { return storage; }
+        const int* labelData() const { return labels.data(); }
+
+        // Row i as its storage type; T must match getType(). Only rows the dataset allocated
+        // can be written.
+        template <typename T>
+        T* row(size_t i) {
+            if (!writable) {
+                throw std::logic_error("Dataset: adopted rows are read-only");
+            }
+            return reinterpret_cast<T*>(writable + i * stride);
+        }
+        template <typename T>
+        const T* row(size_t i) const { return reinterpret_cast<const T*>(storage + i * stride); }
+        int& label(size_t i) { return labels[i]; }
+        int label(size_t i) const { return labels[i]; }
+
+        // Drop every row from `count` on; the buffer is kept
+        void truncate(size_t count);
+
+        DatasetView view() const { return view(0, rows); }
+        DatasetView view(size_t first, size_t count) const;
+        // The rows listed in order, in that order; order must outlive the view
+        DatasetView view(std::span<const size_t> order) const;
+    };
+}
+
+#endif // DATASET_H
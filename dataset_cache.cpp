@@ -0,0 +1,194 @@
+//
+//  dataset_cache.cpp
+//  NeuralNetwork
+//
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "dataset_cache.h"
+#include "mapped_file.h"
+
+namespace NeuralNetwork{
+namespace DatasetCache {
+namespace {
+    constexpr char magic[8] = {'N', 'N', 'C', 'A', 'C', 'H', 'E', '\0'};
+    // Bump whenever the layout below or the Dataset storage format changes
+    constexpr uint32_t version = 1;
+    constexpr uint64_t alignment = 64;
+
+    // Every field is 8-byte aligned so the struct has no padding to leave uninitialised
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t type;
+        uint64_t rows;
+        uint64_t features;
+        uint64_t stride;
+        float scale;
+        float scalingFactor;
+        uint64_t rowLimit;
+        uint64_t sourceBytes;
+        int64_t sourceTime;
+        uint64_t labelsOffset;
+        uint64_t featuresOffset;
+        uint64_t checksum; // of the header (with this field 0), the labels and the features
+    };
+    static_assert(sizeof(Header) == 96, "Header must not contain padding");
+    static_assert(sizeof(int) == sizeof(int32_t), "Labels are stored as 32-bit integers");
+
+    // Fast 64-bit hash, four independent multiply-rotate lanes so the loop runs at memory
+    // speed. It catches truncated and corrupted files, it is not cryptographic.
+    uint64_t checksum(const void* data, size_t bytes, uint64_t seed) {
+        constexpr uint64_t prime = 0x9E3779B97F4A7C15ull;
+        auto mix = [](uint64_t lane, uint64_t word) {
+            lane ^= word;
+            return ((lane << 31) | (lane >> 33)) * prime;
+        };
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        uint64_t lanes[4] = {seed, seed + prime, seed ^ prime, ~seed};
+        size_t i = 0;
+        for (; i + 32 <= bytes; i += 32) {
+            for (int k = 0; k < 4; ++k) {
+                uint64_t word;
+                std::memcpy(&word, p + i + 8 * k, sizeof(word));
+                lanes[k] = mix(lanes[k], word);
+            }
+        }
+        uint64_t hash = bytes;
+        for (uint64_t lane : lanes) {
+            hash = mix(hash, lane);
+        }
+        for (; i < bytes; ++i) {
+            hash = mix(hash, p[i]);
+        }
+        return hash ^ (hash >> 32);
+    }
+
+    uint64_t checksum(const Header& header, const void* labels, const void* features) {
+        Header unsummed = header;
+        unsummed.checksum = 0;
+        uint64_t hash = checksum(&unsummed, sizeof(unsummed), 0);
+        hash = checksum(labels, header.rows * sizeof(int32_t), hash);
+        return checksum(features, header.rows * header.stride, hash);
+    }
+
+    bool matches(const Header& header, const Key& key) {
+        return std::memcmp(header.magic, magic, sizeof(magic)) == 0
+            && header.version == version
+            && header.type == static_cast<uint32_t>(key.type)
+            && header.scalingFactor == key.scalingFactor
+            && header.rowLimit == key.rowLimit
+            && header.sourceBytes == key.sourceBytes
+            && header.sourceTime == key.sourceTime;
+    }
+}
+
+    std::string pathFor(const std::string& source) {
+        return source + ".nncache";
+    }
+
+    Key keyFor(const std::string& source, FeatureType type, float scalingFactor, size_t rowLimit) {
+        Key key;
+        key.sourceBytes = std::filesystem::file_size(source);
+        key.sourceTime = std::filesystem::last_write_time(source).time_since_epoch().count();
+        key.type = type;
+        key.scalingFactor = scalingFactor;
+        key.rowLimit = rowLimit;
+        return key;
+    }
+
+    std::optional<Dataset> load(const std::string& path, const Key& key) {
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(path, error)) {
+            return std::nullopt;
+        }
+        std::shared_ptr<MappedFile> file;
+        try {
+            file = std::make_shared<MappedFile>(path);
+        } catch (const std::runtime_error&) {
+            return std::nullopt;
+        }
+        if (file->size() < sizeof(Header)) {
+            return std::nullopt;
+        }
+        Header header;
+        std::memcpy(&header, file->data(), sizeof(header));
+        if (!matches(header, key)) {
+            return std::nullopt;
+        }
+
+        // The layout has to describe exactly this file before any of it is trusted
+        FeatureType type = key.type;
+        uint64_t size = file->size();
+        if (header.features > size
+            || header.stride < header.features * featureSize(type)
+            || header.labelsOffset < sizeof(Header)
+            || header.featuresOffset % alignment != 0
+            || header.rows > size / sizeof(int32_t)
+            || header.labelsOffset + header.rows * sizeof(int32_t) > header.featuresOffset
+            || (header.stride > 0 && header.rows > size / header.stride)
+            || header.featuresOffset > size
+            || header.featuresOffset + header.rows * header.stride != size) {
+            return std::nullopt;
+        }
+        const unsigned char* base = reinterpret_cast<const unsigned char*>(file->data());
+        if (checksum(header, base + header.labelsOffset, base + header.featuresOffset) != header.checksum) {
+            return std::nullopt;
+        }
+
+        std::vector<int> labels(header.rows);
+        std::memcpy(labels.data(), base + header.labelsOffset, header.rows * sizeof(int32_t));
+        // The rows are used in any order from here on
+        file->readAll();
+        const unsigned char* features = base + header.featuresOffset;
+        return Dataset(std::move(file), features, std::move(labels), header.features, header.stride, type, header.scale);
+    }
+
+    void save(const std::string& path, const Dataset& dataset, const Key& key) {
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.type = static_cast<uint32_t>(dataset.getType());
+        header.rows = dataset.getRows();
+        header.features = dataset.getFeatures();
+        header.stride = dataset.getStride();
+        header.scale = dataset.getScale();
+        header.scalingFactor = key.scalingFactor;
+        header.rowLimit = key.rowLimit;
+        header.sourceBytes = key.sourceBytes;
+        header.sourceTime = key.sourceTime;
+        header.labelsOffset = sizeof(Header);
+        header.featuresOffset = (header.labelsOffset + header.rows * sizeof(int32_t) + alignment - 1) / alignment * alignment;
+        header.checksum = checksum(header, dataset.labelData(), dataset.featureData());
+
+        // Written beside the cache and renamed over it, so a reader never sees half a file
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                throw std::runtime_error("Failed to write dataset cache: " + temporary);
+            }
+            std::vector<char> padding(header.featuresOffset - header.labelsOffset - header.rows * sizeof(int32_t), 0);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(dataset.labelData()), header.rows * sizeof(int32_t));
+            out.write(padding.data(), padding.size());
+            out.write(reinterpret_cast<const char*>(dataset.featureData()), dataset.featureBytes());
+            out.close();
+            if (!out) {
+                std::error_code error;
+                std::filesystem::remove(temporary, error);
+                throw std::runtime_error("Failed to write dataset cache: " + temporary);
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+        if (error) {
+            std::filesystem::remove(temporary, error);
+            throw std::runtime_error("Failed to write dataset cache: " + path);
+        }
+    }
+}
+}
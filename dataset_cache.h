@@ -0,0 +1,50 @@
+//
+//  dataset_cache.h
+//  NeuralNetwork
+//
+//  A parsed dataset saved in binary next to its source, so later runs skip the parse. The
+//  file is a fixed header (rows, features, storage type, scale, stride, the size and
+//  modification time of the source, a checksum), the labels, and then the feature block
+//  exactly as a Dataset holds it, starting on a 64-byte boundary. Loading maps the file and
+//  adopts the feature block in place - nothing is parsed or copied but the labels.
+//
+//  Caches are machine-local: numbers are in native byte order. A cache is used only when it
+//  was built from a source of the same size and modification time with the same storage
+//  type, scaling factor and row limit; anything else is treated as a miss and rebuilt.
+//
+#ifndef DATASET_CACHE_H
+#define DATASET_CACHE_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include "dataset.h"
+
+namespace NeuralNetwork{
+namespace DatasetCache {
+    // What a cache must have been built from to be reused
+    struct Key {
+        uint64_t sourceBytes = 0;
+        int64_t sourceTime = 0; // modification time, in the file clock's ticks
+        FeatureType type = FeatureType::Float32;
+        float scalingFactor = 1.0f;
+        uint64_t rowLimit = 0; // 0 = every row
+    };
+
+    // "<source>.nncache"
+    std::string pathFor(const std::string& source);
+
+    // Key for the current state of a regular source file; throws std::filesystem_error
+    Key keyFor(const std::string& source, FeatureType type, float scalingFactor, size_t rowLimit);
+
+    // The cached dataset, or nothing when the cache is missing, stale, truncated or fails
+    // its checksum
+    std::optional<Dataset> load(const std::string& path, const Key& key);
+
+    // Write the cache atomically (a temporary file renamed into place); throws
+    // std::runtime_error when it cannot be written
+    void save(const std::string& path, const Dataset& dataset, const Key& key);
+}
+}
+
+#endif // DATASET_CACHE_H
@@ -0,0 +1,296 @@
+//
+//  gemm.h
+//  NeuralNetwork
+//
+//  Cache-blocked, register-tiled general matrix multiply used behind Matrix<T>::dot.
+//
+//  C = alpha * A * B + beta * C, where A is m x k, B is k x n and C is m x n (row-major).
+//  A and B are described by a row stride and a column stride, so a transposed operand is
+//  just the same buffer with the strides swapped.
+//
+//  Matrix-vector products skip the packing machinery entirely: gemv and gemvT below stream
+//  the rows of A once, which is all a bandwidth-bound product can do. gemvEpilogue fuses an
+//  element-wise step (bias, activation) into that stream.
+//
+//  The loops follow the usual Goto/BLIS structure:
+//    - B is packed KC x NC at a time into NR-wide column panels (lives in L2/L3)
+//    - A is packed MC x KC at a time into MR-tall row panels (lives in L2)
+//    - an MR x NR micro-kernel keeps its accumulators in registers and streams both
+//      packed panels contiguously (one A panel and one B panel fit in L1)
+//
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#include "simd.h"
+
+namespace NeuralNetwork{
+namespace Gemm {
+    // Portable micro-kernel tile: MR x NR accumulators held in registers. For float the
+    // SIMD table (simd.h) usually supplies a wider tile for the running CPU instead.
+    constexpr size_t MR = 4;
+    constexpr size_t NR = 8;
+
+    // Cache blocking: KC x NR panel of B in L1, MC x KC block of A in L2, KC x NC block of B in L3.
+    // MC is a multiple of every tile height in use (4, 6 and 12).
+    constexpr size_t KC = 256;
+    constexpr size_t MC = 120;
+    constexpr size_t NC = 4096;
+
+    // A read-only operand: element (i, p) lives at data[i * rowStride + p * colStride]
+    template <typename T>
+    struct Operand {
+        const T* data;
+        size_t rowStride;
+        size_t colStride;
+
+        const T& at(size_t i, size_t p) const { return data[i * rowStride + p * colStride]; }
+    };
+
+    // Pack an mc x kc block of A into mrTile-tall panels, each stored column by column
+    // (kc x mrTile). Rows past the edge of the block are zero-filled so the micro-kernel
+    // never branches.
+    template <typename T>
+    void packA(const Operand<T>& a, size_t row0, size_t col0, size_t mc, size_t kc, size_t mrTile, T* packed) {
+        for (size_t i = 0; i < mc; i += mrTile) {
+            size_t mr = std::min(mrTile, mc - i);
+            for (size_t p = 0; p < kc; ++p) {
+                for (size_t r = 0; r < mr; ++r) {
+                    packed[r] = a.at(row0 + i + r, col0 + p);
+                }
+                for (size_t r = mr; r < mrTile; ++r) {
+                    packed[r] = T();
+                }
+                packed += mrTile;
+            }
+        }
+    }
+
+    // Pack a kc x nc block of B into nrTile-wide panels, each stored row by row (kc x nrTile).
+    template <typename T>
+    void packB(const Operand<T>& b, size_t row0, size_t col0, size_t kc, size_t nc, size_t nrTile, T* packed) {
+        for (size_t j = 0; j < nc; j += nrTile) {
+            size_t nr = std::min(nrTile, nc - j);
+            if (b.rowStride == 1) {
+                // Transposed operand: walk each source column (contiguous in memory) down the panel
+                for (size_t c = 0; c < nrTile; ++c) {
+                    for (size_t p = 0; p < kc; ++p) {
+                        packed[p * nrTile + c] = (c < nr) ? b.at(row0 + p, col0 + j + c) : T();
+                    }
+                }
+                packed += kc * nrTile;
+                continue;
+            }
+            for (size_t p = 0; p < kc; ++p) {
+                if (b.colStride == 1 && nr == nrTile) {
+                    // Contiguous row segment - the common, non-transposed case
+                    const T* src = &b.at(row0 + p, col0 + j);
+                    std::copy(src, src + nrTile, packed);
+                } else {
+                    for (size_t c = 0; c < nr; ++c) {
+                        packed[c] = b.at(row0 + p, col0 + j + c);
+                    }
+                    for (size_t c = nr; c < nrTile; ++c) {
+                        packed[c] = T();
+                    }
+                }
+                packed += nrTile;
+            }
+        }
+    }
+
+    // MR x NR register tile: C(mr x nr) = alpha * Apanel * Bpanel + beta * C.
+    // The fixed-size accumulator array and constant trip counts let the compiler keep the
+    // tile in vector registers and fully unroll the inner loops.
+    template <typename T>
+    inline void microKernel(size_t kc, const T* a, const T* b, T alpha, T beta, T* c, size_t ldc, size_t mr, size_t nr) {
+        T acc[MR][NR] = {};
+
+        for (size_t p = 0; p < kc; ++p) {
+            const T* ap = a + p * MR;
+            const T* bp = b + p * NR;
+            for (size_t i = 0; i < MR; ++i) {
+                const T ai = ap[i];
+                for (size_t j = 0; j < NR; ++j) {
+                    acc[i][j] += ai * bp[j];
+                }
+            }
+        }
+
+        for (size_t i = 0; i < mr; ++i) {
+            T* ci = c + i * ldc;
+            if (beta == T()) {
+                // Do not read C at all when beta is zero (it may be uninitialised or NaN)
+                for (size_t j = 0; j < nr; ++j) {
+                    ci[j] = alpha * acc[i][j];
+                }
+            } else {
+                for (size_t j = 0; j < nr; ++j) {
+                    ci[j] = beta * ci[j] + alpha * acc[i][j];
+                }
+            }
+        }
+    }
+
+    // y = A x, A is m x n row-major with leading dimension lda.
+    // Each output is a contiguous row dot product, so A is read exactly once in order.
+    template <typename T>
+    void gemv(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y) {
+        if constexpr (std::is_same_v<T, float>) {
+            const Simd::Kernels& kernels = Simd::kernels();
+            for (size_t i = 0; i < m; ++i) {
+                y[i] = kernels.dot(a + i * lda, x, n);
+            }
+        } else {
+            for (size_t i = 0; i < m; ++i) {
+                const T* ai = a + i * lda;
+                T sum = T();
+                for (size_t j = 0; j < n; ++j) {
+                    sum += ai[j] * x[j];
+                }
+                y[i] = sum;
+            }
+        }
+    }
+
+    // Rows of A x handed to the epilogue at a time by gemvEpilogue
+    constexpr size_t GEMV_BLOCK = 16;
+
+    // y = epilogue(A x), with the epilogue fused into the product: each block of up to
+    // GEMV_BLOCK dot products lands in a stack buffer and epilogue(block, y + i, count) writes
+    // the final values, so the raw products never go out to y and back.
+    template <typename T, typename Epilogue>
+    void gemvEpilogue(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y, Epilogue epilogue) {
+        T block[GEMV_BLOCK];
+        for (size_t i = 0; i < m; i += GEMV_BLOCK) {
+            size_t count = std::min(GEMV_BLOCK, m - i);
+            gemv(count, n, a + i * lda, lda, x, block);
+            epilogue(block, y + i, count);
+        }
+    }
+
+    // y = A^T x, A is m x n row-major with leading dimension lda, so y has n entries.
+    // Accumulated as y += x[i] * row_i, which keeps the walk over A row-major as well.
+    template <typename T>
+    void gemvT(size_t m, size_t n, const T* a, size_t lda, const T* x, T* y) {
+        std::fill(y, y + n, T());
+        if constexpr (std::is_same_v<T, float>) {
+            const Simd::Kernels& kernels = Simd::kernels();
+            for (size_t i = 0; i < m; ++i) {
+                kernels.axpy(x[i], a + i * lda, y, n);
+            }
+        } else {
+            for (size_t i = 0; i < m; ++i) {
+                const T* ai = a + i * lda;
+                for (size_t j = 0; j < n; ++j) {
+                    y[j] += x[i] * ai[j];
+                }
+            }
+        }
+    }
+
+    // Rank-1 update A += alpha * x y^T, A is m x n row-major with leading dimension lda.
+    // One streaming read-modify-write pass over A, nothing else is allocated or written.
+    template <typename T>
+    void ger(size_t m, size_t n, T alpha, const T* x, const T* y, T* a, size_t lda) {
+        if constexpr (std::is_same_v<T, float>) {
+            const Simd::Kernels& kernels = Simd::kernels();
+            for (size_t i = 0; i < m; ++i) {
+                kernels.axpy(alpha * x[i], y, a + i * lda, n);
+            }
+        } else {
+            for (size_t i = 0; i < m; ++i) {
+                T scale = alpha * x[i];
+                T* ai = a + i * lda;
+                for (size_t j = 0; j < n; ++j) {
+                    ai[j] += scale * y[j];
+                }
+            }
+        }
+    }
+
+    // Blocked driver shared by every tile shape: tile(kc, aPanel, bPanel, alpha, beta, cTile, ldc, mr, nr)
+    template <typename T, typename Tile>
+    void gemmBlocked(size_t m, size_t n, size_t k, T alpha, const Operand<T>& a, const Operand<T>& b, T beta, T* c, size_t ldc,
+                     size_t mrTile, size_t nrTile, Tile tile) {
+        // Packing buffers are reused across calls on the same thread, so steady-state
+        // multiplies do not touch the allocator
+        thread_local std::vector<T> packedA;
+        thread_local std::vector<T> packedB;
+
+        // Edge panels are zero-padded out to a whole tile
+        size_t ncMax = (std::min(NC, n) + nrTile - 1) / nrTile * nrTile;
+        size_t mcMax = (std::min(MC, m) + mrTile - 1) / mrTile * mrTile;
+        size_t kcMax = std::min(KC, k);
+        if (packedA.size() < mcMax * kcMax) {
+            packedA.resize(mcMax * kcMax);
+        }
+        if (packedB.size() < ncMax * kcMax) {
+            packedB.resize(ncMax * kcMax);
+        }
+
+        for (size_t jc = 0; jc < n; jc += NC) {
+            size_t nc = std::min(NC, n - jc);
+
+            for (size_t pc = 0; pc < k; pc += KC) {
+                size_t kc = std::min(KC, k - pc);
+                // Only the first slice of the inner dimension applies beta; the rest accumulate
+                T betaBlock = (pc == 0) ? beta : T(1);
+
+                packB(b, pc, jc, kc, nc, nrTile, packedB.data());
+
+                for (size_t ic = 0; ic < m; ic += MC) {
+                    size_t mc = std::min(MC, m - ic);
+
+                    packA(a, ic, pc, mc, kc, mrTile, packedA.data());
+
+                    for (size_t jr = 0; jr < nc; jr += nrTile) {
+                        size_t nr = std::min(nrTile, nc - jr);
+                        const T* bPanel = packedB.data() + jr * kc;
+
+                        for (size_t ir = 0; ir < mc; ir += mrTile) {
+                            size_t mr = std::min(mrTile, mc - ir);
+                            const T* aPanel = packedA.data() + ir * kc;
+                            T* cTile = c + (ic + ir) * ldc + (jc + jr);
+
+                            tile(kc, aPanel, bPanel, alpha, betaBlock, cTile, ldc, mr, nr);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // C = alpha * op(A) * op(B) + beta * C
+    template <typename T>
+    void gemm(size_t m, size_t n, size_t k, T alpha, const Operand<T>& a, const Operand<T>& b, T beta, T* c, size_t ldc) {
+        if (m == 0 || n == 0) {
+            return;
+        }
+
+        if (k == 0) {
+            // Empty inner dimension: the product contributes nothing
+            for (size_t i = 0; i < m; ++i) {
+                for (size_t j = 0; j < n; ++j) {
+                    c[i * ldc + j] = (beta == T()) ? T() : beta * c[i * ldc + j];
+                }
+            }
+            return;
+        }
+
+        if constexpr (std::is_same_v<T, float>) {
+            const Simd::Kernels& kernels = Simd::kernels();
+            if (kernels.gemmTile != nullptr) {
+                gemmBlocked(m, n, k, alpha, a, b, beta, c, ldc, kernels.gemmMR, kernels.gemmNR, kernels.gemmTile);
+                return;
+            }
+        }
+        gemmBlocked(m, n, k, alpha, a, b, beta, c, ldc, MR, NR, microKernel<T>);
+    }
+}
+}
+
+#endif // GEMM_H
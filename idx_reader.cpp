@@ -0,0 +1,100 @@
+//
+//  idx_reader.cpp
+//  NeuralNetwork
+//
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "idx_reader.h"
+#include "mapped_file.h"
+
+namespace NeuralNetwork{
+namespace Idx {
+namespace {
+    constexpr unsigned char unsignedByte = 0x08;
+
+    // The sizes of an IDX file's dimensions and where its elements start
+    struct Header {
+        std::vector<size_t> dims;
+        size_t dataOffset = 0;
+    };
+
+    bool endsWith(const std::string& s, const std::string& suffix) {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    Header readHeader(const MappedFile& file, const std::string& path, size_t expectedDims) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file.data());
+        if (file.size() >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) {
+            throw std::runtime_error("IDX file is gzip-compressed, decompress it first: " + path);
+        }
+        if (file.size() < 4 || bytes[0] != 0 || bytes[1] != 0) {
+            throw std::runtime_error("Not an IDX file: " + path);
+        }
+        if (bytes[2] != unsignedByte) {
+            throw std::runtime_error("IDX file does not hold unsigned bytes: " + path);
+        }
+        if (bytes[3] != expectedDims) {
+            throw std::runtime_error("IDX file has " + std::to_string(bytes[3]) + " dimensions, expected " + std::to_string(expectedDims) + ": " + path);
+        }
+
+        Header header;
+        header.dataOffset = 4 + 4 * expectedDims;
+        if (file.size() < header.dataOffset) {
+            throw std::runtime_error("IDX file is truncated: " + path);
+        }
+        size_t elements = 1;
+        for (size_t d = 0; d < expectedDims; ++d) {
+            const unsigned char* p = bytes + 4 + 4 * d;
+            size_t size = (size_t(p[0]) << 24) | (size_t(p[1]) << 16) | (size_t(p[2]) << 8) | size_t(p[3]);
+            header.dims.push_back(size);
+            elements *= size;
+        }
+        if (file.size() - header.dataOffset < elements) {
+            throw std::runtime_error("IDX file is truncated: " + path);
+        }
+        return header;
+    }
+}
+
+    bool isImagesFile(const std::string& path) {
+        return endsWith(path, "idx3-ubyte");
+    }
+
+    std::string labelsFileFor(const std::string& imagesPath) {
+        for (const char* separator : {"-", "."}) {
+            std::string suffix = std::string("-images") + separator + "idx3-ubyte";
+            if (endsWith(imagesPath, suffix)) {
+                return imagesPath.substr(0, imagesPath.size() - suffix.size()) + "-labels" + separator + "idx1-ubyte";
+            }
+        }
+        throw std::invalid_argument("Cannot derive the IDX labels file from " + imagesPath + "; set labels_file");
+    }
+
+    Dataset load(const std::string& imagesPath, const std::string& labelsPath, float scale, size_t maxRows) {
+        std::vector<int> labels;
+        {
+            MappedFile labelsFile(labelsPath);
+            Header header = readHeader(labelsFile, labelsPath, 1);
+            const unsigned char* values = reinterpret_cast<const unsigned char*>(labelsFile.data()) + header.dataOffset;
+            labels.assign(values, values + header.dims[0]);
+        }
+
+        auto images = std::make_shared<MappedFile>(imagesPath);
+        Header header = readHeader(*images, imagesPath, 3);
+        if (header.dims[0] != labels.size()) {
+            throw std::runtime_error("IDX images file has " + std::to_string(header.dims[0]) + " images but the labels file has " + std::to_string(labels.size()) + " labels");
+        }
+        if (maxRows > 0 && maxRows < labels.size()) {
+            labels.resize(maxRows);
+        }
+
+        // Rows are packed back to back, so the stride is the row length
+        size_t features = header.dims[1] * header.dims[2];
+        const unsigned char* pixels = reinterpret_cast<const unsigned char*>(images->data()) + header.dataOffset;
+        // The rows are used in any order from here on
+        images->readAll();
+        return Dataset(std::move(images), pixels, std::move(labels), features, features, FeatureType::UInt8, scale);
+    }
+}
+}
@@ -0,0 +1,36 @@
+//
+//  idx_reader.h
+//  NeuralNetwork
+//
+//  The IDX format MNIST is distributed in: a magic number (two zero bytes, the element type,
+//  the number of dimensions), one big-endian 32-bit size per dimension, then the elements.
+//  An images file (idx3, n x rows x cols unsigned bytes) is already a dense uint8 dataset,
+//  so it is memory-mapped and adopted as the feature block with nothing parsed or copied;
+//  only the matching labels file (idx1, n unsigned bytes) is read into the label array.
+//
+#ifndef IDX_READER_H
+#define IDX_READER_H
+
+#include <cstddef>
+#include <string>
+#include "dataset.h"
+
+namespace NeuralNetwork{
+namespace Idx {
+    // Whether path is named like an IDX images file ("...idx3-ubyte")
+    bool isImagesFile(const std::string& path);
+
+    // The labels file MNIST ships next to an images file: "train-images-idx3-ubyte" ->
+    // "train-labels-idx1-ubyte" (and likewise for "t10k-images.idx3-ubyte"). Throws
+    // std::invalid_argument when the name does not follow that pattern.
+    std::string labelsFileFor(const std::string& imagesPath);
+
+    // Map the images and read the labels into a uint8 dataset whose features are scaled by
+    // scale, keeping at most maxRows rows when maxRows > 0. The rows stay where the file has
+    // them: unpadded (the stride is the image size) and not cache-line aligned. Throws std::runtime_error for
+    // files that are not unsigned-byte IDX, or whose counts disagree.
+    Dataset load(const std::string& imagesPath, const std::string& labelsPath, float scale, size_t maxRows);
+}
+}
+
+#endif // IDX_READER_H
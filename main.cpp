@@ -13,16 +13,53 @@
 
 using namespace NeuralNetwork;
 
+// Max error of each activation precision tier against double-precision libm, and its speed
+// Every tier on every instruction set this CPU can run; false if any exceeds its bound
+static bool checkActivations() {
+    using namespace ActivationFunctions;
+    bool passed = true;
+    std::cout << std::left << std::setw(10) << "isa" << std::setw(10) << "function" << std::setw(12) << "precision"
+              << std::setw(16) << "max abs error" << std::setw(16) << "max rel error" << std::setw(12) << "bound"
+              << std::setw(12) << "ns/element" << "result" << std::endl;
+    for (int level = static_cast<int>(Simd::Isa::Scalar); level <= static_cast<int>(Simd::supportedIsa()); ++level) {
+        Simd::Isa isa = static_cast<Simd::Isa>(level);
+        for (Activation activation : {Activation::Sigmoid, Activation::Tanh}) {
+            for (Precision precision : {Precision::Exact, Precision::Polynomial, Precision::Table}) {
+                AccuracyReport report = measureAccuracy(activation, precision, isa);
+                passed = passed && report.withinBound;
+                std::cout << std::left << std::setw(10) << Simd::isaName(isa)
+                          << std::setw(10) << (activation == Activation::Sigmoid ? "sigmoid" : "tanh")
+                          << std::setw(12) << precisionName(precision)
+                          << std::setw(16) << std::scientific << std::setprecision(2) << report.maxAbsoluteError
+                          << std::setw(16) << report.maxRelativeError
+                          << std::setw(12) << report.bound
+                          << std::setw(12) << std::fixed << std::setprecision(3) << report.nanosecondsPerElement
+                          << (report.withinBound ? "ok" : "FAIL") << std::endl;
+            }
+        }
+    }
+    return passed;
+}
+
 // main
 int main(int argc, const char * argv[]) {
-    (void) argc;
-    (void) argv;    
+    // --benchmark-hogwild compares Hogwild against the single-threaded loop instead of training
+    bool benchmarkHogwild = argc > 1 && std::string(argv[1]) == "--benchmark-hogwild";
+    // --check-activations reports the accuracy and speed of each activation tier and exits,
+    // non-zero if any tier on any instruction set is outside its bound
+    if (argc > 1 && std::string(argv[1]) == "--check-activations") {
+        return checkActivations() ? 0 : 1;
+    }
     
     //instantiate the neural network
     auto model = Model::fromConfigFile("/Users/richarddalley/Code/c++/NeuralNetworkCPP/mnist/config.json");
     model.printConfiguraton();
     //load the images and alter the values from 0-255, to 0 to 1.0
     model.loadData();
+    if (benchmarkHogwild) {
+        model.benchmarkHogwild(3);
+        return 0;
+    }
     //train the network with the data
     model.train(true);
     // Print the initial configuration of the network
@@ -0,0 +1,98 @@
+//
+//  mapped_file.cpp
+//  NeuralNetwork
+//
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include "mapped_file.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace NeuralNetwork{
+    namespace {
+        // Read granularity of the stream fallback
+        constexpr size_t readBlock = 1 << 20;
+    }
+
+    MappedFile::MappedFile(const std::string& path) {
+#if !defined(_WIN32)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open data file: " + path + " (" + std::strerror(errno) + ")");
+        }
+        struct stat info{};
+        bool regular = ::fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+        if (regular) {
+            length = static_cast<size_t>(info.st_size);
+            if (length > 0) {
+                void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED) {
+                    mapping = mapped;
+                    ::madvise(mapping, length, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        ::close(fd);
+        if (mapping || (length == 0 && regular)) {
+            return;
+        }
+        length = 0;
+#endif
+
+        // Not a regular file (or mmap is unavailable): stream it into the buffer
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open data file: " + path);
+        }
+        while (file) {
+            size_t used = buffer.size();
+            buffer.resize(used + readBlock);
+            file.read(buffer.data() + used, readBlock);
+            buffer.resize(used + static_cast<size_t>(file.gcount()));
+        }
+        if (file.bad()) {
+            throw std::runtime_error("Failed to read data file: " + path);
+        }
+        length = buffer.size();
+    }
+
+    void MappedFile::release(const char* begin, const char* end) const {
+#if !defined(_WIN32)
+        if (!mapping) {
+            return;
+        }
+        // madvise works on whole pages: round the range inwards
+        uintptr_t page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+        uintptr_t first = (reinterpret_cast<uintptr_t>(begin) + page - 1) / page * page;
+        uintptr_t last = reinterpret_cast<uintptr_t>(end) / page * page;
+        if (first < last) {
+            ::madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+        }
+#endif
+    }
+
+    void MappedFile::readAll() const {
+#if !defined(_WIN32)
+        if (mapping) {
+            ::madvise(mapping, length, MADV_NORMAL);
+            ::madvise(mapping, length, MADV_WILLNEED);
+        }
+#endif
+    }
+
+    MappedFile::~MappedFile() {
+#if !defined(_WIN32)
+        if (mapping) {
+            ::munmap(mapping, length);
+        }
+#endif
+    }
+}
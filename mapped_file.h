@@ -0,0 +1,50 @@
+//
+//  mapped_file.h
+//  NeuralNetwork
+//
+//  Read-only access to the whole contents of a file. Regular files are memory-mapped and
+//  parsed in place - no copy on the heap, and the kernel reads ahead because the mapping
+//  is advised as sequential. Anything that cannot be mapped (pipes, character devices,
+//  process substitution) is read through a buffered stream instead.
+//
+//  Pages of a mapping that are read once count towards the resident set until they are
+//  unmapped; release() drops a consumed range from the process (the kernel keeps it in the
+//  page cache), so a file parsed front to back never has to be resident all at once.
+//
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace NeuralNetwork{
+    class MappedFile {
+        void* mapping = nullptr;
+        size_t length = 0;
+        std::string buffer; // fallback storage for files that cannot be mapped
+
+    public:
+        // Throws std::runtime_error when the file cannot be opened or read
+        explicit MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const char* data() const { return mapping ? static_cast<const char*>(mapping) : buffer.data(); }
+        size_t size() const { return length; }
+        const char* begin() const { return data(); }
+        const char* end() const { return data() + length; }
+        bool isMapped() const { return mapping != nullptr; }
+
+        // Drop the whole pages inside [begin, end) from the resident set; they are faulted
+        // back in from the page cache if read again. No-op for buffered files.
+        void release(const char* begin, const char* end) const;
+
+        // For a file that is kept and read in any order rather than streamed through once:
+        // drop the sequential advice and start reading all of it in. No-op for buffered files.
+        void readAll() const;
+    };
+}
+
+#endif // MAPPED_FILE_H
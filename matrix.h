@@ -10,6 +10,11 @@
 #include <random> // For random number generation
 #include <stdexcept>
 #include <iostream>
+#include <span>
+#include <type_traits>
+#include <vector>
+#include "gemm.h"
+#include "simd.h"
 namespace NeuralNetwork{
 template <typename T>
 class Matrix{
@@ -25,6 +30,10 @@ public:
     
     auto begin() const { return data.begin(); }
     auto end() const { return data.end(); }
+
+    // Raw row-major storage, for the span kernels
+    T* values() { return data.data(); }
+    const T* values() const { return data.data(); }
     
     // Constructor to initialize the matrix with given dimensions
     Matrix(size_t rows, size_t cols, T defaultValue = T()) : rows(rows), cols(cols) {
@@ -49,11 +58,10 @@ public:
         }
     }
 
-    // Method to fill the matrix with random values in the range [-1.0, 1.0]
-    void fillRandom() {
-        std::random_device rd;  // Seed
-        std::mt19937 gen(rd()); // Mersenne Twister RNG
-        std::normal_distribution<> dis(0.0, 1.0); // Random floats in [-1.0, 1.0]
+    // Fill the matrix with standard normal values drawn from gen (e.g. a seeded Xoshiro256)
+    template <typename Generator>
+    void fillRandom(Generator& gen) {
+        std::normal_distribution<> dis(0.0, 1.0);
 
         for (size_t i = 0; i < rows * cols; ++i) {
             data[i] = dis(gen); // Assign random value
@@ -109,6 +117,14 @@ public:
         }
     }
 
+    // Copy a vector into one row of the matrix, e.g. to stack samples into a mini-batch
+    void setRow(size_t row, std::span<const T> values) {
+        if (row >= rows || values.size() != cols) {
+            throw std::out_of_range("setRow: row index or vector length out of bounds");
+        }
+        std::copy(values.begin(), values.end(), data.begin() + row * cols);
+    }
+
     std::vector<T> extract() const {
         std::vector<T> result;
 
@@ -142,37 +158,163 @@ public:
         return transposed;
     }   
 
-    Matrix<T> operator*(const Matrix<T>& other) const {
+    // Reshape to newRows x newCols, keeping the existing storage whenever it is large enough.
+    // Contents are unspecified afterwards. The *Into methods below use this on their
+    // destination, so a preallocated destination is never reallocated.
+    void resize(size_t newRows, size_t newCols) {
+        rows = newRows;
+        cols = newCols;
+        data.resize(rows * cols);
+    }
+
+    // Element-wise product into dst (dst may be this or other)
+    void hadamardInto(const Matrix<T>& other, Matrix<T>& dst) const {
         if (rows != other.getRows() || cols != other.getCols()) {
             throw std::invalid_argument("Operator *:Matrix dimensions must match for element-wise multiplication");
         }
 
-        Matrix<T> result(rows, cols);
-        for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < cols; ++j) {
-                result(i, j) = this->data[i * cols + j] * other.data[i * cols + j];  // Element-wise multiplication
+        dst.resize(rows, cols);
+        if constexpr (std::is_same_v<T, float>) {
+            Simd::kernels().mul(this->data.data(), other.data.data(), dst.data.data(), rows * cols);
+        } else {
+            for (size_t i = 0; i < rows * cols; ++i) {
+                dst.data[i] = this->data[i] * other.data[i];  // Element-wise multiplication
             }
         }
+    }
+
+    Matrix<T> operator*(const Matrix<T>& other) const {
+        Matrix<T> result(rows, cols);
+        hadamardInto(other, result);
         return result;
     }
 
-    Matrix<T> dot(const Matrix<T>& other) const {
+    // Matrix product into dst (dst must not be this or other)
+    void dotInto(const Matrix<T>& other, Matrix<T>& dst) const {
         if (cols != other.getRows()) {
             throw std::invalid_argument("matMul: Matrix dimensions do not match for multiplication");
         }
 
+        // A column vector on the right is a matrix-vector product - no packing needed
+        if (other.getCols() == 1) {
+            gemvInto(other, dst);
+            return;
+        }
+
+        dst.resize(rows, other.getCols());
+        // Blocked, packed multiply (see gemm.h) - both operands are plain row-major
+        Gemm::Operand<T> lhs{this->data.data(), cols, 1};
+        Gemm::Operand<T> rhs{other.data.data(), other.getCols(), 1};
+        Gemm::gemm(rows, other.getCols(), cols, T(1), lhs, rhs, T(), dst.data.data(), dst.getCols());
+    }
+
+    Matrix<T> dot(const Matrix<T>& other) const {
         Matrix<T> result(rows, other.getCols());
-        for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < other.getCols(); ++j) {
-                T sum = T();  // Initialize sum to zero
-                for (size_t k = 0; k < cols; ++k) {
-                    size_t lhsIndex = i * cols + k;  // Flat index for left-hand side
-                    size_t rhsIndex = k * other.getCols() + j;  // Flat index for right-hand side
-                    sum += this->data[lhsIndex] * other.data[rhsIndex];
+        dotInto(other, result);
+        return result;
+    }
+
+    // this^T * other into dst, without materialising the transpose (BLAS transA = 'T')
+    void dotTNInto(const Matrix<T>& other, Matrix<T>& dst) const {
+        if (rows != other.getRows()) {
+            throw std::invalid_argument("dotTN: Matrix dimensions do not match for multiplication");
+        }
+
+        if (other.getCols() == 1) {
+            gemvTInto(other, dst);
+            return;
+        }
+
+        dst.resize(cols, other.getCols());
+        // Element (i, p) of this^T is this(p, i): swap the strides instead of copying
+        Gemm::Operand<T> lhs{this->data.data(), 1, cols};
+        Gemm::Operand<T> rhs{other.data.data(), other.getCols(), 1};
+        Gemm::gemm(cols, other.getCols(), rows, T(1), lhs, rhs, T(), dst.data.data(), dst.getCols());
+    }
+
+    Matrix<T> dotTN(const Matrix<T>& other) const {
+        Matrix<T> result(cols, other.getCols());
+        dotTNInto(other, result);
+        return result;
+    }
+
+    // this * other^T into dst, without materialising the transpose (BLAS transB = 'T')
+    void dotNTInto(const Matrix<T>& other, Matrix<T>& dst) const {
+        if (cols != other.getCols()) {
+            throw std::invalid_argument("dotNT: Matrix dimensions do not match for multiplication");
+        }
+
+        if (other.getRows() == 1) {
+            // other^T is a column vector
+            gemvInto(other, dst);
+            return;
+        }
+
+        dst.resize(rows, other.getRows());
+        if (cols == 1) {
+            // Two column vectors: x * y^T is an outer product, row i is y scaled by x[i]
+            for (size_t i = 0; i < rows; ++i) {
+                T* resultRow = dst.data.data() + i * other.getRows();
+                if constexpr (std::is_same_v<T, float>) {
+                    Simd::kernels().scale(other.data.data(), this->data[i], resultRow, other.getRows());
+                } else {
+                    for (size_t j = 0; j < other.getRows(); ++j) {
+                        resultRow[j] = this->data[i] * other.data[j];
+                    }
                 }
-                result(i, j) = sum;  // Store result
             }
+            return;
         }
+
+        if (rows == 1) {
+            // A single row times other^T is other times that row: a GEMV, stored as a row
+            dst.resize(1, other.getRows());
+            Gemm::gemv(other.getRows(), other.getCols(), other.data.data(), other.getCols(), this->data.data(), dst.data.data());
+            return;
+        }
+
+        // Element (p, j) of other^T is other(j, p)
+        Gemm::Operand<T> lhs{this->data.data(), cols, 1};
+        Gemm::Operand<T> rhs{other.data.data(), 1, other.getCols()};
+        Gemm::gemm(rows, other.getRows(), cols, T(1), lhs, rhs, T(), dst.data.data(), dst.getCols());
+    }
+
+    Matrix<T> dotNT(const Matrix<T>& other) const {
+        Matrix<T> result(rows, other.getRows());
+        dotNTInto(other, result);
+        return result;
+    }
+
+    // Matrix-vector product y = A x into dst. x may be a row or a column vector; y is a
+    // column vector (dst must not be this or x).
+    void gemvInto(const Matrix<T>& x, Matrix<T>& dst) const {
+        if (x.data.size() != cols || (x.rows != 1 && x.cols != 1)) {
+            throw std::invalid_argument("gemv: vector length must match the matrix columns");
+        }
+
+        dst.resize(rows, 1);
+        Gemm::gemv(rows, cols, this->data.data(), cols, x.data.data(), dst.data.data());
+    }
+
+    Matrix<T> gemv(const Matrix<T>& x) const {
+        Matrix<T> result(rows, 1);
+        gemvInto(x, result);
+        return result;
+    }
+
+    // Transposed matrix-vector product y = A^T x into dst, without materialising A^T
+    void gemvTInto(const Matrix<T>& x, Matrix<T>& dst) const {
+        if (x.data.size() != rows || (x.rows != 1 && x.cols != 1)) {
+            throw std::invalid_argument("gemvT: vector length must match the matrix rows");
+        }
+
+        dst.resize(cols, 1);
+        Gemm::gemvT(rows, cols, this->data.data(), cols, x.data.data(), dst.data.data());
+    }
+
+    Matrix<T> gemvT(const Matrix<T>& x) const {
+        Matrix<T> result(cols, 1);
+        gemvTInto(x, result);
         return result;
     }
 
@@ -180,8 +322,12 @@ public:
         Matrix<T> result(rows, cols);
 
         // Scale each element by the scalar
-        for (size_t i = 0; i < rows * cols; ++i) {
-            result.data[i] = this->data[i] * scalar;
+        if constexpr (std::is_same_v<T, float>) {
+            Simd::kernels().scale(this->data.data(), scalar, result.data.data(), rows * cols);
+        } else {
+            for (size_t i = 0; i < rows * cols; ++i) {
+                result.data[i] = this->data[i] * scalar;
+            }
         }
 
         return result;  // Return the new scaled matrix
@@ -189,8 +335,12 @@ public:
  
     Matrix<T>& operator*=(T scalar) {
         // Scale each element by the scalar
-        for (size_t i = 0; i < rows * cols; ++i) {
-            this->data[i] *= scalar;
+        if constexpr (std::is_same_v<T, float>) {
+            Simd::kernels().scale(this->data.data(), scalar, this->data.data(), rows * cols);
+        } else {
+            for (size_t i = 0; i < rows * cols; ++i) {
+                this->data[i] *= scalar;
+            }
         }
 
         return *this;  // Return reference to the modified matrix
@@ -212,71 +362,130 @@ public:
         // Create result matrix with dimensions (rows of this x cols of other)
         Matrix<T> result(this->rows, other.cols);
 
-        // Perform outer product
+        // Perform outer product - row i is the row vector scaled by this[i]
         for (size_t i = 0; i < this->rows; ++i) {
-            for (size_t j = 0; j < other.cols; ++j) {
-                size_t indexResult = i * other.cols + j;  // Index in the result matrix
-                size_t indexA = i;  // Since this is a column vector, row index matches flat index
-                size_t indexB = j;  // Since the other is a row vector, col index matches flat index
-
-                result.data[indexResult] = this->data[indexA] * other.data[indexB];
+            T* resultRow = result.data.data() + i * other.cols;
+            if constexpr (std::is_same_v<T, float>) {
+                Simd::kernels().scale(other.data.data(), this->data[i], resultRow, other.cols);
+            } else {
+                for (size_t j = 0; j < other.cols; ++j) {
+                    resultRow[j] = this->data[i] * other.data[j];
+                }
             }
         }
 
         return result;
     }    
 
-    // subtract one matrix from another
-    Matrix<T> operator-(const Matrix<T>& other) const {
+    // In-place rank-1 update this += alpha * x * y^T (BLAS ger), for x with one entry per
+    // row and y with one entry per column. Replaces x.dot(y.transpose()) * alpha followed
+    // by +=, which writes two full-size temporaries.
+    Matrix<T>& ger(T alpha, const Matrix<T>& x, const Matrix<T>& y) {
+        if (x.data.size() != rows || (x.rows != 1 && x.cols != 1)) {
+            throw std::invalid_argument("ger: x must be a vector with one entry per row");
+        }
+        if (y.data.size() != cols || (y.rows != 1 && y.cols != 1)) {
+            throw std::invalid_argument("ger: y must be a vector with one entry per column");
+        }
+
+        Gemm::ger(rows, cols, alpha, x.data.data(), y.data.data(), this->data.data(), cols);
+        return *this;
+    }
+
+    // In-place this += alpha * a^T * b, without materialising the transpose (GEMM with
+    // beta = 1). With one sample per row of a and b this accumulates the summed weight
+    // gradient of a mini-batch straight into the weights.
+    Matrix<T>& addProductTN(T alpha, const Matrix<T>& a, const Matrix<T>& b) {
+        if (a.getRows() != b.getRows() || a.getCols() != rows || b.getCols() != cols) {
+            throw std::invalid_argument("addProductTN: Matrix dimensions do not match for multiplication");
+        }
+
+        if (a.getRows() == 1) {
+            // A single sample is a rank-1 update
+            return ger(alpha, a, b);
+        }
+
+        Gemm::Operand<T> lhs{a.data.data(), 1, a.getCols()};
+        Gemm::Operand<T> rhs{b.data.data(), b.getCols(), 1};
+        Gemm::gemm(rows, cols, a.getRows(), alpha, lhs, rhs, T(1), this->data.data(), cols);
+        return *this;
+    }
+
+    // In-place this += alpha * other (BLAS axpy)
+    Matrix<T>& axpy(T alpha, const Matrix<T>& other) {
+        if (rows != other.getRows() || cols != other.getCols()) {
+            throw std::invalid_argument("axpy: Matrix dimensions do not match");
+        }
+
+        if constexpr (std::is_same_v<T, float>) {
+            Simd::kernels().axpy(alpha, other.data.data(), this->data.data(), rows * cols);
+        } else {
+            for (size_t i = 0; i < rows * cols; ++i) {
+                this->data[i] += alpha * other.data[i];
+            }
+        }
+        return *this;
+    }
+
+    // subtract other from this into dst (dst may be this or other)
+    void subtractInto(const Matrix<T>& other, Matrix<T>& dst) const {
         // Ensure the dimensions match for subtraction
         if (rows != other.getRows() || cols != other.getCols()) {
             throw std::invalid_argument("Matrix dimensions do not match for subtraction");
         }
 
-        // Create a result matrix with the same dimensions
-        Matrix<T> result(rows, cols);
+        dst.resize(rows, cols);
 
         // Perform element-wise subtraction
         size_t totalSize = rows * cols;  // Calculate total number of elements
-        for (size_t i = 0; i < totalSize; ++i) {
-            result.data[i] = this->data[i] - other.data[i];
+        if constexpr (std::is_same_v<T, float>) {
+            Simd::kernels().sub(this->data.data(), other.data.data(), dst.data.data(), totalSize);
+        } else {
+            for (size_t i = 0; i < totalSize; ++i) {
+                dst.data[i] = this->data[i] - other.data[i];
+            }
         }
+    }
 
+    // subtract one matrix from another
+    Matrix<T> operator-(const Matrix<T>& other) const {
+        // Create a result matrix with the same dimensions
+        Matrix<T> result(rows, cols);
+        subtractInto(other, result);
         return result;
     }    
 
-    // append another matrix to this
-    Matrix<T>& operator+=(const Matrix<T>& other) {
+    // add other to this into dst (dst may be this or other)
+    void addInto(const Matrix<T>& other, Matrix<T>& dst) const {
         // Ensure the dimensions match for addition
         if (rows != other.getRows() || cols != other.getCols()) {
             throw std::invalid_argument("Matrix dimensions do not match for addition");
         }
 
+        dst.resize(rows, cols);
+
         // Perform element-wise addition
         size_t totalSize = rows * cols;  // Total number of elements
-        for (size_t i = 0; i < totalSize; ++i) {
-            this->data[i] += other.data[i];
+        if constexpr (std::is_same_v<T, float>) {
+            Simd::kernels().add(this->data.data(), other.data.data(), dst.data.data(), totalSize);
+        } else {
+            for (size_t i = 0; i < totalSize; ++i) {
+                dst.data[i] = this->data[i] + other.data[i];
+            }
         }
+    }
 
+    // append another matrix to this
+    Matrix<T>& operator+=(const Matrix<T>& other) {
+        addInto(other, *this);
         return *this; // Return reference to the modified matrix
     }
 
     // return the sum of two operators
     Matrix<T> operator+(const Matrix<T>& other) const {
-        // Ensure the dimensions match for addition
-        if (rows != other.getRows() || cols != other.getCols()) {
-            throw std::invalid_argument("Matrix dimensions do not match for addition");
-        }
-
         // Create a new matrix to store the result
         Matrix<T> result(rows, cols);
-
-        // Perform element-wise addition
-        size_t totalSize = rows * cols;
-        for (size_t i = 0; i < totalSize; ++i) {
-            result.data[i] = this->data[i] + other.data[i];
-        }
-
+        addInto(other, result);
         return result; // Return the new matrix
     }
 
@@ -5,129 +5,171 @@
 //  Created by Richard Dalley on 2025-01-16.
 //
 
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
 #include <fstream>
+#include <numeric>
 #include <cmath> // For std::pow
 #include <json.hpp>
 #include "model.h"
+#include "allocation_counter.h"
+#include "batch_prefetcher.h"
+#include "csv_parser.h"
+#include "data_stream.h"
+#include "dataset_cache.h"
+#include "idx_reader.h"
+#include "mapped_file.h"
 
 
 using namespace NeuralNetwork::ActivationFunctions;
 
 namespace NeuralNetwork{
-// load data using std::getline
+namespace {
+    // Streams of the run's seed, one per consumer
+    constexpr uint64_t weightStream = 0;
+    constexpr uint64_t shuffleStream = 1;
+}
+
+// load data into one contiguous Dataset: a CSV file with the label first on every line, then
+// the features, or a pair of IDX images and labels files
 void Model::loadData() {
-    std::ifstream file(dataFile, std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open data file: " + dataFile);
+    // Streamed data is read during each epoch instead; nothing is held here
+    if (streaming) {
+        if (!std::filesystem::exists(dataFile)) {
+            throw std::runtime_error("Failed to open data file: " + dataFile);
+        }
+        size_t rowBytes = (inputNodes * featureSize(featureType) + 63) / 64 * 64;
+        size_t shuffleRows = shuffleData ? shuffleBuffer : 1;
+        size_t bufferedRows = (streamRingShards + 1) * shardRows + shuffleRows;
+        std::stringstream ss;
+        ss << "Streaming " << dataFile << " in shards of " << shardRows << " rows through a shuffle buffer of "
+           << shuffleRows << " rows; " << std::fixed << std::setprecision(1) << bufferedRows * rowBytes / 1e6
+           << " MB of " << featureTypeName(featureType) << " features buffered" << std::endl;
+        if (validationSplit > 0.0) {
+            ss << "validation_split is ignored: a streamed run trains on every row and holds none out" << std::endl;
+        }
+        std::cout << ss.str();
+        trainingSet = DatasetView();
+        validationSet = DatasetView();
+        return;
     }
 
-    // Reserve memory if the number of rows is specified
-    if (this->dataRows > 0) {
-        labels.reserve(dataRows);
-        data.reserve(dataRows);
+    // Parse on the training threads; a pool is borrowed for the load when training does not
+    // keep one
+    std::unique_ptr<ThreadPool> loadPool;
+    ThreadPool* parsePool = pool.get();
+    if (!parsePool && threads > 1) {
+        loadPool = std::make_unique<ThreadPool>(threads);
+        parsePool = loadPool.get();
     }
 
-    std::string buffer;
-    if (this->dataRows > 0) {
-        // Optimized processing
-        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
-
-        size_t start = 0, end = 0;
-        int rowCount = 0;
-
-        while (rowCount < dataRows && (end = buffer.find('\n', start)) != std::string::npos) {
-            std::string_view line(buffer.data() + start, end - start);
-            start = end + 1;
-
-            std::stringstream ss((std::string(line))); // Use double parentheses
-            std::string value;
-            std::vector<float> row;
-            int label;
-
-            // Read the label (first value in the row)
-            std::getline(ss, value, ',');
-            label = std::stoi(value);
-            labels.push_back(label);
+    auto parseStart = std::chrono::steady_clock::now();
+    // Set when the rows come ready-made from a binary file and there is nothing to parse
+    std::string loadedFrom;
+    std::string cachePath;
+    DatasetCache::Key cacheKey;
+    if (dataFormat == DataFormat::Idx) {
+        // IDX images already are a uint8 tensor: mapped and used in place
+        dataset = Idx::load(dataFile, labelsFile, 1.0f / scalingFactor, this->dataRows);
+        loadedFrom = dataFile;
+    } else if (dataCache && std::filesystem::is_regular_file(dataFile)) {
+        // A binary cache beside a regular source file skips the parse on every later run; it
+        // is keyed on the source's size and modification time, taken before the source is read
+        cachePath = DatasetCache::pathFor(dataFile);
+        cacheKey = DatasetCache::keyFor(dataFile, featureType, scalingFactor, this->dataRows);
+        if (auto hit = DatasetCache::load(cachePath, cacheKey)) {
+            dataset = std::move(*hit);
+            loadedFrom = cachePath;
+        }
+    }
 
-            // Read the pixel values
-            while (std::getline(ss, value, ',')) {
-                row.push_back(std::stof(value) / scalingFactor); // Normalize to [0, 1]
-            }
-            data.push_back(std::move(row));
-            ++rowCount;
+    // Parsed straight out of the page cache, releasing the mapping chunk by chunk, so the text
+    // and the dataset are never both held in memory
+    size_t parsedBytes = 0; // the text the rows came from, short of the file under a row cap
+    bool mapped = false;
+    if (loadedFrom.empty()) {
+        MappedFile file(dataFile);
+        mapped = file.isMapped();
+        // lines_in_file rows when given, otherwise every non-empty line. Float features are
+        // stored already scaled; compact ones keep the raw integers and carry the scale.
+        dataset = Csv::load(file, featureType, scalingFactor, this->dataRows, parsePool, &parsedBytes);
+    }
+    if (dataset.getFeatures() != static_cast<size_t>(inputNodes)) {
+        throw std::runtime_error("Data file has " + std::to_string(dataset.getFeatures()) + " features per row, the model expects " + std::to_string(inputNodes));
+    }
+    size_t rowCount = dataset.getRows();
+    dataRows = rowCount;
+    // Whatever the loader, every label has to name an output; a bad one would otherwise only
+    // fail when its row is first trained on
+    for (size_t i = 0; i < rowCount; ++i) {
+        int label = dataset.label(i);
+        if (label < 0 || label >= outputNodes) {
+            throw std::runtime_error("Row " + std::to_string(i) + " of " + (loadedFrom.empty() ? dataFile : loadedFrom) + " has label "
+                                     + std::to_string(label) + "; labels must be 0 to " + std::to_string(outputNodes - 1));
         }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - parseStart).count();
+    double megabytes = parsedBytes / 1e6;
+    std::stringstream ss;
+    if (!loadedFrom.empty()) {
+        ss << "Loaded " << rowCount << " rows from " << loadedFrom << " in " << std::fixed << std::setprecision(1)
+           << seconds * 1000.0 << " ms; " << dataset.featureBytes() / 1e6 << " MB of "
+           << featureTypeName(dataset.getType()) << " features" << std::endl;
     } else {
-        // Default processing using std::getline
-        std::string line;
-        while (std::getline(file, line)) {
-            std::stringstream ss(line);
-            std::string value;
-            std::vector<float> row;
-            int label;
-
-            // Read the label (first value in the row)
-            std::getline(ss, value, ',');
-            label = std::stoi(value);
-            labels.push_back(label);
-
-            // Read the pixel values
-            while (std::getline(ss, value, ',')) {
-                row.push_back(std::stof(value) / scalingFactor); // Normalize to [0, 1]
-            }
-            data.push_back(std::move(row));
+        ss << "Parsed " << rowCount << " rows (" << std::fixed << std::setprecision(1) << megabytes << " MB, "
+           << (mapped ? "mapped" : "read") << ") in "
+           << seconds * 1000.0 << " ms, " << megabytes / std::max(seconds, 1e-9) << " MB/s; "
+           << dataset.featureBytes() / 1e6 << " MB of " << featureTypeName(dataset.getType()) << " features, "
+           << (parsePool ? parsePool->size() : 1) << " threads" << std::endl;
+    }
+    std::cout << ss.str();
+
+    // A cache that cannot be written (read-only directory, full disk) only costs the next
+    // run its parse
+    if (loadedFrom.empty() && !cachePath.empty()) {
+        try {
+            DatasetCache::save(cachePath, dataset, cacheKey);
+        } catch (const std::runtime_error& e) {
+            std::cout << e.what() << std::endl;
         }
     }
 
+    // Training and validation rows are picked through a permutation of the row indices; the
+    // rows themselves never move
+    order.resize(rowCount);
+    std::iota(order.begin(), order.end(), static_cast<size_t>(0));
+
     // Shuffle data if enabled
     if (this->shuffleData) {
-        shuffle();
+        shuffle(order.size());
     }
 
     // Split data if validation split is enabled
     if (this->validationSplit > 0.0) {
         splitData();
     } else {
-        splitIndex = dataRows;
-        trainingData = std::move(data);
-        trainingLabels = std::move(labels);
+        splitIndex = rowCount;
+        trainingSet = dataset.view({order.data(), splitIndex});
+        validationSet = DatasetView();
     }
 }
 
 
-void Model::shuffle(){
-    // Create a vector of indices to shuffle
-    std::vector<size_t> indices(data.size());
-    std::iota(indices.begin(), indices.end(), 0); // Fill with 0, 1, ..., data.size() - 1
-
-    // Create a random device and a random number generator
-    std::random_device rd;
-    std::mt19937 g(rd());
-
-    // Shuffle the indices
-    std::shuffle(indices.begin(), indices.end(), g);
-
-    // Use the shuffled indices to reorder data and labels
-    std::vector<std::vector<float>> shuffledData;
-    std::vector<int> shuffledLabels;
-
-    for (size_t idx : indices) {
-        shuffledData.push_back(data[idx]);
-        shuffledLabels.push_back(labels[idx]);
-    }
-
-    // Replace original data and labels with shuffled versions
-    data = std::move(shuffledData);
-    labels = std::move(shuffledLabels);
+// Shuffle the first `count` entries of the row order - O(count) index swaps, no row data
+// moves
+void Model::shuffle(size_t count){
+    std::shuffle(order.begin(), order.begin() + count, shuffleRng);
 }
 
+// Training and validation sets are views through the row order, over the one dataset
+// buffer; nothing is copied
 void Model::splitData(){
-    this->splitIndex = static_cast<size_t>(data.size() * (1 - validationSplit));
-
-    trainingData.assign(data.begin(), data.begin() + splitIndex);
-    trainingLabels.assign(labels.begin(), labels.begin() + splitIndex);
+    this->splitIndex = static_cast<size_t>(dataset.getRows() * (1 - validationSplit));
 
-    validationData.assign(data.begin() + splitIndex, data.end());
-    validationLabels.assign(labels.begin() + splitIndex, labels.end());
+    trainingSet = dataset.view({order.data(), splitIndex});
+    validationSet = dataset.view({order.data() + splitIndex, dataset.getRows() - splitIndex});
 }
 
 void printFirstImageInVector(std::vector<std::vector<float>>& images, std::vector<int>& labels){
@@ -142,18 +184,107 @@ void printFirstImageInVector(std::vector<std::vector<float>>& images, std::vecto
     
 }
 
-Model::Model(int inputNodes, int hiddenNodes, int outputNodes, float learningRate, float scalingFactor, bool shuffleData, float validationSplit, std::string dataFile, size_t dataRows)
-: inputNodes(inputNodes),
-  hiddenNodes(hiddenNodes),
-  outputNodes(outputNodes),
-  learningRate(learningRate),
-  scalingFactor(scalingFactor),
-  shuffleData(shuffleData),
-  validationSplit(validationSplit),
-  dataFile(dataFile),
-  dataRows(dataRows),
+Workspace::Workspace(int inputNodes, int hiddenNodes, int outputNodes)
+: targets(outputNodes, 1),
+  hiddenOutputs(hiddenNodes, 1),
+  finalOutputs(outputNodes, 1),
+  outputErrors(outputNodes, 1),
+  hiddenErrors(hiddenNodes, 1),
+  outputGradients(outputNodes, 1),
+  hiddenGradients(hiddenNodes, 1),
+  inputs(inputNodes, 0.0f),
+  outputLayer(outputNodes, 0.0f)
+{
+}
+
+BatchWorkspace::BatchWorkspace(int inputNodes, int hiddenNodes, int outputNodes, size_t batchSize)
+: inputs(batchSize, inputNodes),
+  targets(batchSize, outputNodes),
+  hiddenInputs(batchSize, hiddenNodes),
+  hiddenOutputs(batchSize, hiddenNodes),
+  finalInputs(batchSize, outputNodes),
+  finalOutputs(batchSize, outputNodes),
+  outputErrors(batchSize, outputNodes),
+  hiddenErrors(batchSize, hiddenNodes),
+  outputGradients(batchSize, outputNodes),
+  hiddenGradients(batchSize, hiddenNodes)
+{
+}
+
+WorkerState::WorkerState(int inputNodes, int hiddenNodes, int outputNodes, size_t batchSize)
+: workspace(inputNodes, hiddenNodes, outputNodes, batchSize),
+  inputHiddenGradient(batchSize > 0 ? hiddenNodes : 0, inputNodes),
+  hiddenOutputGradient(batchSize > 0 ? outputNodes : 0, hiddenNodes),
+  inputs(inputNodes, 0.0f),
+  hidden(hiddenNodes, 0.0f),
+  hiddenErrors(hiddenNodes, 0.0f),
+  outputLayer(outputNodes, 0.0f),
+  outputErrors(outputNodes, 0.0f),
+  confidence(outputNodes, 0.0f)
+{
+}
+
+// Copy m into row-padded storage: each row starts on a 64-byte boundary and the stride is
+// rounded up to a whole number of cache lines
+void PaddedWeights::load(const Matrix<float>& m) {
+    constexpr size_t lineFloats = 64 / sizeof(float);
+    rows = m.getRows();
+    cols = m.getCols();
+    stride = (cols + lineFloats - 1) / lineFloats * lineFloats;
+    storage.assign(rows * stride + lineFloats, 0.0f);
+
+    // Align the first row; the allocation is only guaranteed to be float-aligned
+    size_t offset = (64 - reinterpret_cast<uintptr_t>(storage.data()) % 64) % 64 / sizeof(float);
+    data = storage.data() + offset;
+
+    auto source = m.begin();
+    for (size_t i = 0; i < rows; ++i) {
+        std::copy(source + i * cols, source + (i + 1) * cols, data + i * stride);
+    }
+}
+
+// Copy the padded rows back into m
+void PaddedWeights::store(Matrix<float>& m) const {
+    auto target = m.begin();
+    for (size_t i = 0; i < rows; ++i) {
+        std::copy(data + i * stride, data + i * stride + cols, target + i * cols);
+    }
+}
+
+Model::Model(const ModelConfig& config)
+: inputNodes(config.inputNodes),
+  hiddenNodes(config.hiddenNodes),
+  outputNodes(config.outputNodes),
+  epochs(std::max<size_t>(config.epochs, 1)),
+  learningRate(config.learningRate),
+  scalingFactor(config.scalingFactor),
+  shuffleData(config.shuffleData),
+  validationSplit(config.validationSplit),
+  dataRows(config.dataRows),
+  batchSize(std::max<size_t>(config.batchSize, 1)),
+  // 0 means one thread per hardware thread
+  threads(config.threads > 0 ? config.threads : std::max(1u, std::thread::hardware_concurrency())),
+  hogwild(config.hogwild),
+  postUpdateMetrics(config.postUpdateMetrics),
+  activationPrecision(config.activationPrecision),
+  featureType(config.featureType),
+  dataCache(config.dataCache),
+  dataFormat(config.dataFormat),
+  labelsFile(config.labelsFile),
+  streaming(config.streaming),
+  // A chunk of streamed rows holds at least one batch
+  shardRows(std::max({config.shardRows, batchSize, static_cast<size_t>(1)})),
+  shuffleBuffer(std::max<size_t>(config.shuffleBuffer, 1)),
+  seed(config.seed),
+  weightRng(seed, weightStream),
+  shuffleRng(seed, shuffleStream),
   inputHiddenWeights(hiddenNodes, inputNodes, 0.0f),
-  hiddenOutputWeights(outputNodes, hiddenNodes, 0.0f)
+  hiddenOutputWeights(outputNodes, hiddenNodes, 0.0f),
+  dataFile(config.dataFile),
+  workspace(inputNodes, hiddenNodes, outputNodes),
+  // Only allocate batch-sized scratch space when mini-batching is on
+  batchWorkspace(inputNodes, hiddenNodes, outputNodes, batchSize > 1 ? batchSize : 0),
+  evaluateEachEpoch(config.evaluateEachEpoch)
 {
     // Randomize weights using normal distribution
     if (validationSplit > 0.0){
@@ -161,19 +292,25 @@ Model::Model(int inputNodes, int hiddenNodes, int outputNodes, float learningRat
     }
     initializeWeights(inputHiddenWeights, inputNodes);
     initializeWeights(hiddenOutputWeights, hiddenNodes);
+
+    // Worker threads help when a batch has more than one sample to split, or for Hogwild
+    if (threads > 1 && (batchSize > 1 || hogwild)) {
+        pool = std::make_unique<ThreadPool>(threads);
+        size_t perWorker = (batchSize > 1) ? (batchSize + threads - 1) / threads : 0;
+        workers.reserve(threads);
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back(inputNodes, hiddenNodes, outputNodes, perWorker);
+        }
+    }
+
+    // Mini-batches are assembled in the background, one slice per worker when data-parallel
+    if (config.prefetchBatches && batchSize > 1) {
+        prefetcher = std::make_unique<BatchPrefetcher>(batchSize, pool ? workers.size() : 1, outputNodes);
+    }
 }
 
 Model Model::fromConfigFile(const std::string& configFileLocation) {
-    // Local variables to hold configuration
-    int inputNodes = 0;
-    int hiddenNodes = 0;
-    int outputNodes = 0;
-    float learningRate = 0.0f;
-    float scalingFactor = 0.0f;
-    bool shuffleData = true;
-    float validationSplit = 0.1;
-    size_t dataRows = 0;
-    std::string dataFile;
+    ModelConfig settings;
 
     // Load the configuration
     std::ifstream configFile(configFileLocation);
@@ -187,22 +324,71 @@ Model Model::fromConfigFile(const std::string& configFileLocation) {
         configFile >> config;
 
         // Extract configuration values
-        inputNodes = config.at("input_nodes").get<int>();
-        hiddenNodes = config.at("hidden_nodes").get<int>();
-        outputNodes = config.at("output_classes").get<int>();
-        learningRate = config.at("learning_rate").get<float>();
-        scalingFactor = config.at("scaling_factor").get<float>();
-        shuffleData = config.at("shuffle_data").get<bool>();
-        validationSplit = config.at("validation_split").get<float>();
-        dataFile = config.at("data_file").get<std::string>();
-        dataRows = config.at("lines_in_file").get<size_t>();
+        settings.inputNodes = config.at("input_nodes").get<int>();
+        settings.hiddenNodes = config.at("hidden_nodes").get<int>();
+        settings.outputNodes = config.at("output_classes").get<int>();
+        settings.learningRate = config.at("learning_rate").get<float>();
+        settings.scalingFactor = config.at("scaling_factor").get<float>();
+        settings.shuffleData = config.at("shuffle_data").get<bool>();
+        settings.validationSplit = config.at("validation_split").get<float>();
+        settings.dataFile = config.at("data_file").get<std::string>();
+        settings.dataRows = config.at("lines_in_file").get<size_t>();
+        // Optional: passes over the training data
+        settings.epochs = config.value("epochs", settings.epochs);
+        // Optional: samples per weight update (1 = per-sample SGD)
+        settings.batchSize = config.value("batch_size", settings.batchSize);
+        // Optional: training threads (0 = all hardware threads)
+        settings.threads = config.value("threads", settings.threads);
+        // Optional: lock-free asynchronous SGD across the threads
+        settings.hogwild = config.value("hogwild", settings.hogwild);
+        // Optional: score training samples with a second forward pass after each update
+        settings.postUpdateMetrics = config.value("post_update_metrics", settings.postUpdateMetrics);
+        // Optional: "exact", "polynomial" or "table" sigmoid
+        settings.activationPrecision = precisionFromName(config.value("activation_precision", std::string("polynomial")));
+        // Optional: "float32", "uint8" or "uint16" feature storage
+        settings.featureType = featureTypeFromName(config.value("feature_type", std::string("float32")));
+        // Optional: keep a parsed binary copy of the data file in <data_file>.nncache
+        settings.dataCache = config.value("data_cache", settings.dataCache);
+        // Optional: "csv" or "idx"; by default IDX when data_file is named like "...idx3-ubyte"
+        settings.dataFormat = dataFormatFromName(config.value("data_format", std::string(Idx::isImagesFile(settings.dataFile) ? "idx" : "csv")));
+        // Optional: the IDX labels file, by default the one MNIST names after data_file
+        if (settings.dataFormat == DataFormat::Idx) {
+            // IDX pixels are used as they are on disk
+            settings.featureType = FeatureType::UInt8;
+            settings.labelsFile = config.value("labels_file", std::string());
+            if (settings.labelsFile.empty()) {
+                settings.labelsFile = Idx::labelsFileFor(settings.dataFile);
+            }
+        }
+        // Optional: read the CSV from disk during every epoch instead of holding it in memory,
+        // shard_rows rows at a time, shuffled through a buffer of shuffle_buffer rows
+        settings.streaming = config.value("streaming", settings.streaming);
+        settings.shardRows = config.value("shard_rows", settings.shardRows);
+        settings.shuffleBuffer = config.value("shuffle_buffer", settings.shuffleBuffer);
+        // Optional: assemble each mini-batch on a background thread while the previous one trains
+        settings.prefetchBatches = config.value("prefetch_batches", settings.prefetchBatches);
+        // Optional: evaluate the validation rows after every epoch, in the background
+        settings.evaluateEachEpoch = config.value("evaluate_each_epoch", settings.evaluateEachEpoch);
+        // Optional: seed for weight initialisation and shuffling, so a run can be repeated;
+        // a fresh one from the system when absent (it is printed with the configuration)
+        if (config.contains("seed")) {
+            settings.seed = config.at("seed").get<uint64_t>();
+        } else {
+            std::random_device rd;
+            settings.seed = (static_cast<uint64_t>(rd()) << 32) | rd();
+        }
+        if (settings.streaming && settings.dataFormat != DataFormat::Csv) {
+            throw std::invalid_argument("streaming reads CSV data files; IDX files are memory-mapped already");
+        }
+        if (settings.streaming && settings.evaluateEachEpoch) {
+            throw std::invalid_argument("evaluate_each_epoch needs validation rows, and a streamed run holds none out");
+        }
 
     } catch (const std::exception& e) {
         throw std::runtime_error("Error parsing config file: " + std::string(e.what()));
     }
 
-    // Use the non-static constructor to create the neuralNetwork object
-    return Model(inputNodes, hiddenNodes, outputNodes, learningRate, scalingFactor, shuffleData, validationSplit, dataFile, dataRows);
+    return Model(settings);
 }
 
 void Model::initializeWeights(Matrix<float>& matrix, int nodesInPreviousLayer) {
@@ -210,7 +396,7 @@ void Model::initializeWeights(Matrix<float>& matrix, int nodesInPreviousLayer) {
 
     for (size_t i = 0; i < matrix.getRows(); ++i) {
         for (size_t j = 0; j < matrix.getCols(); ++j) {
-            matrix(i, j) = dist(gen);  // Using () instead of []
+            matrix(i, j) = dist(weightRng);  // Using () instead of []
         }
     }
 }
@@ -223,75 +409,61 @@ void Model::train(bool showProgress){
     int correctPredictions = 0; // To track training accuracy
 
     confidenceChanges = std::vector<float>(digits, 0.0);
-    size_t dataSize = trainingData.size();
+    size_t dataSize = trainingSet.size();
     // Train the network with the input and target
     if (showProgress){
         std::cout << "\nTraining the network\n" << std::endl;
     }
+    size_t allocationsBefore = Debug::heapAllocations();
     for (size_t iter = 0; iter < epochs; ++iter) {
         totalLoss = 0.0f; // Reset total loss for the epoch
         correctPredictions = 0; // Reset correct predictions for the epoch
 
-        for (size_t i = 0; i < dataSize; ++i) {
-            //initialize the inuputLayer from the image
-            std::vector<float> inputLayer = trainingData[i];
-            //initialize the output vector
-            std::vector<float> targetLayer(10, 0.1);
-            targetLayer[trainingLabels[i]] = 0.99; // One-hot encoding
-                                           //train it epoch times
-            trainLayer(inputLayer, targetLayer);
-            // Get output/confidence for the current input
-            Matrix<float> output = forwardPass(inputLayer);
-            
-            
-            // Calculate loss for this input
-            std::vector<float> outputLayer = output.extract(); // Convert Matrix to vector
-            float loss = calculateLoss(outputLayer, trainingLabels[i]);
-            totalLoss += loss;
-
-            // Determine the predicted digit
-            int predictedLabel = getPredictedLabel(outputLayer);
-            if (predictedLabel == trainingLabels[i]) {
-                ++correctPredictions;
-            }
-            
-            // Update max confidence for the corresponding digit
-            for (size_t digit = 0; digit < digits; ++digit) {
-                if (outputLayer[digit] > confidenceChanges[digit]) {
-                    confidenceChanges[digit] = outputLayer[digit];
-                }
-            }
+        // A new order of the training rows every epoch; the first was shuffled at load, and
+        // the validation rows stay where the split put them
+        if (shuffleData && !streaming && iter > 0) {
+            shuffle(splitIndex);
+        }
 
-            // if the user wants to show the progress of the training
-            if (showProgress) { //set to false to train faster
-                if (i > 0){
-                    size_t prog = (iter * i) + i;
-                    if (prog % 1000 == 0) {
-                        std::cout << "." << std::flush;
-                        if (prog % 10000 == 0) {
-                            std::cout << " " << std::flush; 
-                        }
-                    }
-                } else {
-                     std::cout << "Progress: " << std::flush;
-                }
-            }
+        if (streaming) {
+            dataSize = trainEpochStreaming(iter, showProgress, totalLoss, correctPredictions);
+        } else if (hogwild && pool) {
+            trainEpochHogwild(totalLoss, correctPredictions);
+        } else {
+            trainEpoch(iter, showProgress, totalLoss, correctPredictions);
         }
         
         // Print epoch metrics
         if (showProgress) {
-            float averageLoss = totalLoss / dataSize;
-            float accuracy = static_cast<float>(correctPredictions) / dataSize * 100.0f;
+            float averageLoss = totalLoss / std::max<size_t>(dataSize, 1);
+            float accuracy = static_cast<float>(correctPredictions) / std::max<size_t>(dataSize, 1) * 100.0f;
 
             std::cout << "\nEpoch " << iter + 1 << "/" << epochs
                       << " - Loss: " << averageLoss
                       << ", Accuracy: " << accuracy << "%\n";
         }
-
+        if (evaluateEachEpoch && !validationSet.empty()) {
+            evaluateEpoch(iter);
+        }
     }
     if (showProgress){
         std::cout << std::endl;
     }
+    if (Debug::countingAllocations()) {
+        size_t allocations = Debug::heapAllocations() - allocationsBefore;
+        std::cout << "Heap allocations in the training loop: " << allocations
+                  << " (" << static_cast<double>(allocations) / std::max<size_t>(dataSize * epochs, 1) << " per sample)" << std::endl;
+    }
+    if (pool && parallelSeconds > 0.0) {
+        // Share of the workers' available time spent computing inside the parallel steps
+        double busy = 0.0;
+        for (const WorkerState& worker : workers) {
+            busy += worker.busySeconds;
+        }
+        double efficiency = busy / (parallelSeconds * workers.size()) * 100.0;
+        std::cout << "Parallel efficiency: " << std::fixed << std::setprecision(1) << efficiency
+                  << "% across " << workers.size() << " threads (busy time / threads x wall time)" << std::endl;
+    }
     // Capture the end time
     auto end = std::chrono::high_resolution_clock::now();
 
@@ -300,40 +472,560 @@ void Model::train(bool showProgress){
     std::cout << "Training completed in " << duration << " milliseconds." << std::endl;
 }
 
+// One synchronous pass over the training data: per-sample SGD, or mini-batches (optionally
+// data-parallel) when batchSize > 1. Metrics come from the forward pass the training step
+// already made, before its update, unless postUpdateMetrics asks for a second pass with the
+// updated weights.
+void Model::trainEpoch(size_t iter, bool showProgress, float& totalLoss, int& correctPredictions) {
+    std::vector<float>& outputLayer = workspace.outputLayer;
+    size_t dataSize = trainingSet.size();
+    if (prefetcher && batchSize > 1) {
+        prefetcher->start(trainingSet);
+    }
 
+    for (size_t i = 0; i < dataSize; i += batchSize) {
+        size_t count = std::min(batchSize, dataSize - i);
 
-void Model::trainLayer(const std::vector<float>& inputLayer, const std::vector<float>& targetLayer) {
-    Matrix<float> inputs(inputLayer);
-    Matrix<float> targets(targetLayer);
+        if (batchSize == 1) {
+            // Float samples are read in place; compact ones are converted into the workspace
+            std::span<const float> inputs = trainingSet.sample(i, workspace.inputs.data());
+            const Matrix<float>* output = &trainLayer(inputs, trainingSet.label(i));
+            if (postUpdateMetrics) {
+                // Get output/confidence for the current input with the updated weights
+                output = &forwardPass(inputs);
+            }
 
-    // Make a forward pass - computing hidden and final outputs
-    Matrix<float> hiddenInputs = inputHiddenWeights.dot( inputs);
-    Matrix<float> hiddenOutputs = applyNew(hiddenInputs, sigmoid);
+            // Calculate loss for this input
+            outputLayer.assign(output->begin(), output->end()); // Copy into the reused output vector
+            scoreOutput(outputLayer, trainingSet.label(i), totalLoss, correctPredictions);
+            if (showProgress) {
+                printProgress(iter, progressOffset + i);
+            }
+            continue;
+        }
 
-    Matrix<float> finalInputs = hiddenOutputWeights.dot(hiddenOutputs);
-    Matrix<float> finalOutputs = applyNew(finalInputs, sigmoid);
+        if (pool) {
+            // Data-parallel step; each worker's slice is scored from its own forward pass
+            trainBatchParallel(i, count);
+            size_t active = std::min(workers.size(), count);
+            if (postUpdateMetrics) {
+                auto forward = [this](size_t t) { forwardBatch(workers[t].workspace); };
+                pool->run(active, forward);
+            }
+            for (size_t t = 0; t < active; ++t) {
+                scoreBatch(workers[t].workspace.finalOutputs, sliceStart(i, count, active, t), iter, showProgress, totalLoss, correctPredictions);
+            }
+            continue;
+        }
 
-    // Calculate the output errors
-    Matrix<float> outputErrors = targets - finalOutputs;
-    Matrix<float> hiddenErrors = hiddenOutputWeights.transpose().dot(outputErrors);
+        if (!takePrefetchedBatch(i, count)) {
+            BatchPrefetcher::stack(trainingSet.slice(i, count), batchWorkspace.inputs, batchWorkspace.targets, outputNodes);
+        }
+        const Matrix<float>* outputs = &trainBatch(batchWorkspace);
+        if (postUpdateMetrics) {
+            // Get output/confidence for the batch with the updated weights
+            outputs = &forwardBatch(batchWorkspace);
+        }
+        scoreBatch(*outputs, i, iter, showProgress, totalLoss, correctPredictions);
+    }
+}
+
+// One pass over a data file streamed from disk. The reader thread parses shards ahead of
+// training; each chunk of shuffled rows is trained with the in-memory epoch loop as if it
+// were the whole training set, so every training mode works unchanged. Chunks are a whole
+// number of batches. Returns the number of rows trained on.
+size_t Model::trainEpochStreaming(size_t iter, bool showProgress, float& totalLoss, int& correctPredictions) {
+    // A one-row shuffle buffer hands the rows out in file order
+    size_t shuffleRows = shuffleData ? shuffleBuffer : 1;
+    DataStream stream(dataFile, inputNodes, outputNodes, featureType, scalingFactor, shardRows, streamRingShards, shuffleRows, dataRows, shuffleRng());
+    size_t chunkRows = shardRows / batchSize * batchSize;
+    size_t rows = 0;
+    for (DatasetView chunk = stream.next(chunkRows); !chunk.empty(); chunk = stream.next(chunkRows)) {
+        trainingSet = chunk;
+        progressOffset = rows;
+        if (hogwild && pool) {
+            trainEpochHogwild(totalLoss, correctPredictions);
+        } else {
+            trainEpoch(iter, showProgress, totalLoss, correctPredictions);
+        }
+        rows += chunk.size();
+    }
+    trainingSet = DatasetView();
+    progressOffset = 0;
+    return rows;
+}
+
+// Hogwild! epoch (Niu et al., 2011): every worker runs per-sample SGD over its own shard of
+// the training data and writes straight into the shared weights with no locks. Updates from
+// different threads may interleave or overwrite each other; for sparse-ish gradients this
+// costs little accuracy and removes all synchronisation. The weights are staged in
+// row-padded copies for the epoch so each row starts on its own cache line.
+//
+// Loss and accuracy come from each sample's forward pass before its update.
+void Model::trainEpochHogwild(float& totalLoss, int& correctPredictions) {
+    sharedInputHidden.load(inputHiddenWeights);
+    sharedHiddenOutput.load(hiddenOutputWeights);
+
+    size_t dataSize = trainingSet.size();
+    size_t shards = workers.size();
+    auto parallelStart = std::chrono::steady_clock::now();
+
+    auto trainShard = [this, dataSize, shards](size_t t) {
+        auto begin = std::chrono::steady_clock::now();
+        WorkerState& worker = workers[t];
+        worker.loss = 0.0f;
+        worker.correct = 0;
+        std::fill(worker.confidence.begin(), worker.confidence.end(), 0.0f);
+
+        for (size_t i = sliceStart(0, dataSize, shards, t); i < sliceStart(0, dataSize, shards, t + 1); ++i) {
+            hogwildStep(worker, trainingSet.sample(i, worker.inputs.data()).data(), trainingSet.label(i));
+        }
 
-    // Update weights for hidden-to-output
-    Matrix<float> outputGradients = applyNew(finalOutputs, [](float x) { return x * (1.0f - x); });
-    Matrix<float> scaledOutputErrors = outputErrors * outputGradients;
-    Matrix<float> weightDeltaOutput = scaledOutputErrors.dot(hiddenOutputs.transpose());
-    weightDeltaOutput = weightDeltaOutput * learningRate;
-    hiddenOutputWeights += weightDeltaOutput;
+        worker.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    };
+    pool->run(shards, trainShard);
 
-    // Update weights for input-to-hidden
-    Matrix<float> hiddenGradients = applyNew(hiddenOutputs, [](float x) { return x * (1.0f - x); });
+    parallelSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - parallelStart).count();
 
-    Matrix<float> scaledHiddenErrors = hiddenErrors * hiddenGradients;
+    sharedInputHidden.store(inputHiddenWeights);
+    sharedHiddenOutput.store(hiddenOutputWeights);
 
-    
-    Matrix<float> weightDeltaInput = scaledHiddenErrors.dot(inputs.transpose());
+    for (const WorkerState& worker : workers) {
+        totalLoss += worker.loss;
+        correctPredictions += worker.correct;
+        for (size_t digit = 0; digit < digits; ++digit) {
+            confidenceChanges[digit] = std::max(confidenceChanges[digit], worker.confidence[digit]);
+        }
+    }
+}
+
+// One lock-free SGD step on the shared padded weights - the trainLayer arithmetic on raw
+// rows, with the worker's own scratch vectors
+void Model::hogwildStep(WorkerState& worker, const float* inputs, int label) {
+    PaddedWeights& w1 = sharedInputHidden;
+    PaddedWeights& w2 = sharedHiddenOutput;
+    float* hidden = worker.hidden.data();
+    float* output = worker.outputLayer.data();
+    float* outputErrors = worker.outputErrors.data();
+    float* hiddenErrors = worker.hiddenErrors.data();
+
+    // Forward pass
+    denseSpan(w1.rows, w1.cols, w1.data, w1.stride, inputs, nullptr, hidden, Activation::Sigmoid, activationPrecision);
+    denseSpan(w2.rows, w2.cols, w2.data, w2.stride, hidden, nullptr, output, Activation::Sigmoid, activationPrecision);
+
+    // Score the pre-update output
+    worker.loss += calculateLoss(worker.outputLayer, label);
+    if (getPredictedLabel(worker.outputLayer) == label) {
+        ++worker.correct;
+    }
+    for (size_t digit = 0; digit < digits; ++digit) {
+        worker.confidence[digit] = std::max(worker.confidence[digit], output[digit]);
+    }
+
+    // Output errors against the one-hot target, back-projected before W2 changes
+    for (int o = 0; o < outputNodes; ++o) {
+        outputErrors[o] = ((o == label) ? 0.99f : 0.1f) - output[o];
+    }
+    Gemm::gemvT(w2.rows, w2.cols, w2.data, w2.stride, outputErrors, hiddenErrors);
+
+    // Scale by the sigmoid gradients and update both layers in place
+    for (int o = 0; o < outputNodes; ++o) {
+        outputErrors[o] *= sigmoidDerivativeFromOutput(output[o]);
+    }
+    Gemm::ger(w2.rows, w2.cols, learningRate, outputErrors, hidden, w2.data, w2.stride);
+
+    for (int h = 0; h < hiddenNodes; ++h) {
+        hiddenErrors[h] *= sigmoidDerivativeFromOutput(hidden[h]);
+    }
+    Gemm::ger(w1.rows, w1.cols, learningRate, hiddenErrors, inputs, w1.data, w1.stride);
+}
+
+// Mean loss and accuracy (%) of the current weights over the validation set, or over the
+// training set when there is no validation split
+std::pair<float, float> Model::measureLoss() {
+    const DatasetView& samples = validationSet.empty() ? trainingSet : validationSet;
+    std::vector<float>& outputLayer = workspace.outputLayer;
+
+    float loss = 0.0f;
+    int correct = 0;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const Matrix<float>& output = forwardPass(samples.sample(i, workspace.inputs.data()));
+        outputLayer.assign(output.begin(), output.end());
+        loss += calculateLoss(outputLayer, samples.label(i));
+        if (getPredictedLabel(outputLayer) == samples.label(i)) {
+            ++correct;
+        }
+    }
+    size_t n = std::max<size_t>(samples.size(), 1);
+    return {loss / n, static_cast<float>(correct) / n * 100.0f};
+}
+
+// Train the same initial weights with the synchronous single-threaded loop and with Hogwild,
+// and print held-out loss against wall-clock time after every epoch, so the two can be
+// compared on convergence per second. The model is left with its initial weights.
+void Model::benchmarkHogwild(size_t benchmarkEpochs) {
+    if (!pool) {
+        throw std::runtime_error("benchmarkHogwild needs threads > 1 in the configuration");
+    }
+    if (streaming) {
+        throw std::runtime_error("benchmarkHogwild needs the data in memory; turn off streaming");
+    }
+
+    Matrix<float> initialInputHidden = inputHiddenWeights;
+    Matrix<float> initialHiddenOutput = hiddenOutputWeights;
+    confidenceChanges = std::vector<float>(digits, 0.0);
 
-    weightDeltaInput *= learningRate;
-    inputHiddenWeights += weightDeltaInput;
+    std::cout << "\nHogwild benchmark: " << trainingSet.size() << " training samples, "
+              << workers.size() << " threads, " << benchmarkEpochs << " epochs\n"
+              << std::left << std::setw(12) << "mode" << std::setw(8) << "epoch"
+              << std::setw(14) << "elapsed ms" << std::setw(12) << "loss" << std::setw(12) << "accuracy %"
+              << "loss drop / s" << std::endl;
+
+    for (bool useHogwild : {false, true}) {
+        inputHiddenWeights = initialInputHidden;
+        hiddenOutputWeights = initialHiddenOutput;
+        // The single-threaded reference is plain per-sample SGD, the same update Hogwild makes
+        size_t savedBatchSize = batchSize;
+        batchSize = 1;
+
+        float initialLoss = measureLoss().first;
+        double elapsed = 0.0;
+        for (size_t iter = 0; iter < benchmarkEpochs; ++iter) {
+            float totalLoss = 0.0f;
+            int correct = 0;
+            auto begin = std::chrono::steady_clock::now();
+            if (useHogwild) {
+                trainEpochHogwild(totalLoss, correct);
+            } else {
+                trainEpoch(iter, false, totalLoss, correct);
+            }
+            elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+            std::pair<float, float> measured = measureLoss();
+            std::cout << std::left << std::setw(12) << (useHogwild ? "hogwild" : "single")
+                      << std::setw(8) << iter + 1
+                      << std::setw(14) << std::fixed << std::setprecision(1) << elapsed * 1000.0
+                      << std::setw(12) << std::setprecision(4) << measured.first
+                      << std::setw(12) << std::setprecision(2) << measured.second
+                      << std::setprecision(4) << (initialLoss - measured.first) / elapsed << std::endl;
+        }
+        batchSize = savedBatchSize;
+    }
+
+    inputHiddenWeights = initialInputHidden;
+    hiddenOutputWeights = initialHiddenOutput;
+}
+
+Evaluation Model::evaluate(const DatasetView& samples) {
+    // On the training threads; a pool is borrowed for the pass when training does not keep one
+    std::unique_ptr<ThreadPool> evaluationPool;
+    ThreadPool* threadPool = pool.get();
+    if (!threadPool && threads > 1) {
+        evaluationPool = std::make_unique<ThreadPool>(threads);
+        threadPool = evaluationPool.get();
+    }
+    return evaluateWith(samples, inputHiddenWeights, hiddenOutputWeights, threadPool);
+}
+
+// Metrics of the weights w1 and w2 over samples. The rows are split into one even shard per
+// thread of threadPool (or a single shard without one); each shard is stacked and run
+// forward evaluationBatch rows at a time in its own workspace and tallied separately, so the
+// shards share nothing until their tallies are merged. Only reads the model's state.
+Evaluation Model::evaluateWith(const DatasetView& samples, const Matrix<float>& w1, const Matrix<float>& w2, ThreadPool* threadPool) {
+    auto begin = std::chrono::steady_clock::now();
+    size_t classes = static_cast<size_t>(outputNodes);
+    size_t shards = threadPool ? std::min(threadPool->size(), std::max<size_t>(samples.size(), 1)) : 1;
+
+    std::vector<Evaluation> tallies(shards);
+    auto evaluateShard = [&](size_t s) {
+        Evaluation& tally = tallies[s];
+        tally.confusion.assign(classes * classes, 0);
+        BatchWorkspace bw(inputNodes, hiddenNodes, outputNodes, 0);
+        std::vector<float> outputLayer(classes);
+
+        size_t end = sliceStart(0, samples.size(), shards, s + 1);
+        for (size_t first = sliceStart(0, samples.size(), shards, s); first < end; first += evaluationBatch) {
+            DatasetView rows = samples.slice(first, std::min(evaluationBatch, end - first));
+            BatchPrefetcher::stack(rows, bw.inputs, bw.targets, classes);
+            const Matrix<float>& outputs = forwardBatch(bw, w1, w2);
+            for (size_t b = 0; b < rows.size(); ++b) {
+                auto row = outputs.begin() + b * classes;
+                outputLayer.assign(row, row + classes);
+                int label = rows.label(b);
+                int predicted = getPredictedLabel(outputLayer);
+                tally.loss += calculateLoss(outputLayer, label);
+                tally.correct += (predicted == label) ? 1 : 0;
+                ++tally.confusion[label * classes + predicted];
+            }
+        }
+    };
+    if (threadPool) {
+        threadPool->run(shards, evaluateShard);
+    } else {
+        evaluateShard(0);
+    }
+
+    Evaluation result;
+    result.samples = samples.size();
+    result.classes = classes;
+    result.confusion.assign(classes * classes, 0);
+    for (const Evaluation& tally : tallies) {
+        result.loss += tally.loss;
+        result.correct += tally.correct;
+        for (size_t i = 0; i < result.confusion.size(); ++i) {
+            result.confusion[i] += tally.confusion[i];
+        }
+    }
+    size_t n = std::max<size_t>(result.samples, 1);
+    result.loss /= n;
+    result.accuracy = static_cast<float>(result.correct) / n * 100.0f;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    result.samplesPerSecond = result.seconds > 0.0 ? result.samples / result.seconds : 0.0;
+    return result;
+}
+
+// Validation after epoch `iter`. The previous epoch's background evaluation is collected and
+// printed first. Every epoch but the last then copies its weights and evaluates the copy on
+// a thread of its own while the next epoch trains, so validation costs the training loop
+// only the copy; the last epoch has nothing to overlap with and evaluates on the training threads.
+void Model::evaluateEpoch(size_t iter) {
+    if (pendingEvaluation.valid()) {
+        printEvaluation(pendingEvaluation.get(), "Validation after epoch " + std::to_string(iter), false);
+    }
+    if (iter + 1 < epochs) {
+        snapshotInputHidden = inputHiddenWeights;
+        snapshotHiddenOutput = hiddenOutputWeights;
+        // The validation rows of order are never reshuffled, so the view stays valid while
+        // training reorders the rest
+        pendingEvaluation = std::async(std::launch::async, [this] {
+            return evaluateWith(validationSet, snapshotInputHidden, snapshotHiddenOutput, nullptr);
+        });
+    } else {
+        printEvaluation(evaluate(validationSet), "Validation after epoch " + std::to_string(iter + 1), true);
+    }
+}
+
+// One line of metrics, then the confusion matrix (rows are true labels, columns predictions)
+// when asked for
+void Model::printEvaluation(const Evaluation& evaluation, const std::string& title, bool confusion) {
+    std::stringstream ss;
+    ss << title << " - Loss: " << std::fixed << std::setprecision(4) << evaluation.loss
+       << ", Accuracy: " << std::setprecision(2) << evaluation.accuracy << "% over " << evaluation.samples
+       << " samples (" << std::setprecision(0) << evaluation.samplesPerSecond << " samples/s)\n";
+    if (confusion) {
+        ss << "Confusion matrix (rows: true label, columns: predicted):\n" << std::setw(6) << "";
+        for (size_t p = 0; p < evaluation.classes; ++p) {
+            ss << std::setw(7) << p;
+        }
+        ss << "\n";
+        for (size_t t = 0; t < evaluation.classes; ++t) {
+            ss << std::setw(6) << t;
+            for (size_t p = 0; p < evaluation.classes; ++p) {
+                ss << std::setw(7) << evaluation.confusion[t * evaluation.classes + p];
+            }
+            ss << "\n";
+        }
+    }
+    std::cout << ss.str();
+}
+
+// Accumulate loss, accuracy and peak confidence for one output vector
+void Model::scoreOutput(const std::vector<float>& outputLayer, int label, float& totalLoss, int& correctPredictions) {
+    float loss = calculateLoss(outputLayer, label);
+    totalLoss += loss;
+
+    // Determine the predicted digit
+    int predictedLabel = getPredictedLabel(outputLayer);
+    if (predictedLabel == label) {
+        ++correctPredictions;
+    }
+
+    // Update max confidence for the corresponding digit
+    for (size_t digit = 0; digit < digits; ++digit) {
+        if (outputLayer[digit] > confidenceChanges[digit]) {
+            confidenceChanges[digit] = outputLayer[digit];
+        }
+    }
+}
+
+// Print a dot every 1000 samples and a space every 10000
+void Model::printProgress(size_t iter, size_t i) {
+    if (i > 0){
+        size_t prog = (iter * i) + i;
+        if (prog % 1000 == 0) {
+            std::cout << "." << std::flush;
+            if (prog % 10000 == 0) {
+                std::cout << " " << std::flush; 
+            }
+        }
+    } else {
+         std::cout << "Progress: " << std::flush;
+    }
+}
+
+// Score a batch of outputs whose first row is training sample `first`
+void Model::scoreBatch(const Matrix<float>& outputs, size_t first, size_t iter, bool showProgress, float& totalLoss, int& correctPredictions) {
+    std::vector<float>& outputLayer = workspace.outputLayer;
+    for (size_t b = 0; b < outputs.getRows(); ++b) {
+        auto row = outputs.begin() + b * outputNodes;
+        outputLayer.assign(row, row + outputNodes);
+        scoreOutput(outputLayer, trainingSet.label(first + b), totalLoss, correctPredictions);
+        if (showProgress) {
+            printProgress(iter, progressOffset + first + b);
+        }
+    }
+}
+
+// Swap the prefetched batch of `count` training rows from `first` into the workspaces:
+// batchWorkspace, or one slice per worker for the data-parallel step. Returns false when
+// prefetching is off and the rows still have to be stacked.
+bool Model::takePrefetchedBatch(size_t first, size_t count) {
+    if (!prefetcher) {
+        return false;
+    }
+    BatchPrefetcher::Batch* batch = prefetcher->acquire();
+    if (!batch || batch->first != first || batch->count != count) {
+        throw std::logic_error("Prefetched batch does not match the training step");
+    }
+    for (size_t p = 0; p < batch->slices; ++p) {
+        BatchWorkspace& bw = pool ? workers[p].workspace : batchWorkspace;
+        std::swap(bw.inputs, batch->inputs[p]);
+        std::swap(bw.targets, batch->targets[p]);
+    }
+    prefetcher->release(batch);
+    return true;
+}
+
+// Forward and backward pass for the batch stacked in bw. Leaves the scaled output errors in
+// bw.outputGradients and the scaled hidden errors in bw.hiddenGradients; the weights are
+// only read.
+void Model::backpropagate(BatchWorkspace& bw) {
+    // Forward pass: H = sigmoid(X W1^T), Y = sigmoid(H W2^T)
+    forwardBatch(bw);
+
+    // Output errors, and their back-projection through the (not yet updated) output weights
+    bw.targets.subtractInto(bw.finalOutputs, bw.outputErrors);
+    bw.outputErrors.dotInto(hiddenOutputWeights, bw.hiddenErrors);
+
+    applyDerivativeInto(bw.finalOutputs, bw.outputGradients, Activation::Sigmoid);
+    bw.outputErrors.hadamardInto(bw.outputGradients, bw.outputGradients); // scaled output errors
+
+    applyDerivativeInto(bw.hiddenOutputs, bw.hiddenGradients, Activation::Sigmoid);
+    bw.hiddenErrors.hadamardInto(bw.hiddenGradients, bw.hiddenGradients); // scaled hidden errors
+}
+
+// One mini-batch step on the batch stacked in bw (batch x inputNodes, one sample per row).
+// Both layers run as matrix-matrix products and the weights get a single update with the
+// gradient averaged over the batch. Returns the outputs from before the update.
+const Matrix<float>& Model::trainBatch(BatchWorkspace& bw) {
+    float rate = learningRate / static_cast<float>(bw.inputs.getRows());
+    backpropagate(bw);
+
+    // W2 += rate * scaledOutputErrors^T H and W1 += rate * scaledHiddenErrors^T X, in place
+    hiddenOutputWeights.addProductTN(rate, bw.outputGradients, bw.hiddenOutputs);
+    inputHiddenWeights.addProductTN(rate, bw.hiddenGradients, bw.inputs);
+    return bw.finalOutputs;
+}
+
+// First training sample of worker t's share when `count` samples from `first` are split
+// evenly over `active` workers
+size_t Model::sliceStart(size_t first, size_t count, size_t active, size_t t) {
+    return first + t * count / active;
+}
+
+// Data-parallel mini-batch step. Each worker stacks and back-propagates its own slice of the
+// batch into private gradient buffers, a pairwise tree reduction sums the buffers into
+// worker 0's, and the weights get one update. Weights are read-only until the reduction
+// is done, so the workers need no locking.
+void Model::trainBatchParallel(size_t first, size_t count) {
+    size_t active = std::min(workers.size(), count);
+    auto parallelStart = std::chrono::steady_clock::now();
+    bool prefetched = takePrefetchedBatch(first, count);
+
+    auto computeGradients = [this, first, count, active, prefetched](size_t t) {
+        auto begin = std::chrono::steady_clock::now();
+        WorkerState& worker = workers[t];
+        size_t start = sliceStart(first, count, active, t);
+        size_t end = sliceStart(first, count, active, t + 1);
+
+        if (!prefetched) {
+            BatchPrefetcher::stack(trainingSet.slice(start, end - start), worker.workspace.inputs, worker.workspace.targets, outputNodes);
+        }
+        backpropagate(worker.workspace);
+        worker.workspace.outputGradients.dotTNInto(worker.workspace.hiddenOutputs, worker.hiddenOutputGradient);
+        worker.workspace.hiddenGradients.dotTNInto(worker.workspace.inputs, worker.inputHiddenGradient);
+
+        worker.busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    };
+    pool->run(active, computeGradients);
+
+    // Tree reduction: after the round with stride s, worker t (t a multiple of 2s) holds the
+    // sum of workers t .. t + 2s - 1. log2(active) rounds, each running in parallel.
+    for (size_t stride = 1; stride < active; stride *= 2) {
+        auto reduce = [this, stride, active](size_t pair) {
+            auto begin = std::chrono::steady_clock::now();
+            size_t target = pair * 2 * stride;
+            size_t source = target + stride;
+            if (source < active) {
+                workers[target].hiddenOutputGradient += workers[source].hiddenOutputGradient;
+                workers[target].inputHiddenGradient += workers[source].inputHiddenGradient;
+            }
+            workers[target].busySeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        };
+        pool->run((active + 2 * stride - 1) / (2 * stride), reduce);
+    }
+
+    parallelSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - parallelStart).count();
+
+    float rate = learningRate / static_cast<float>(count);
+    hiddenOutputWeights.axpy(rate, workers[0].hiddenOutputGradient);
+    inputHiddenWeights.axpy(rate, workers[0].inputHiddenGradient);
+}
+
+// Forward pass for the batch stacked in bw; returns batch x outputNodes inside bw
+const Matrix<float>& Model::forwardBatch(BatchWorkspace& bw) {
+    return forwardBatch(bw, inputHiddenWeights, hiddenOutputWeights);
+}
+
+// The same with weights w1 (hidden x inputs) and w2 (outputs x hidden) in place of the model's
+const Matrix<float>& Model::forwardBatch(BatchWorkspace& bw, const Matrix<float>& w1, const Matrix<float>& w2) const {
+    bw.inputs.dotNTInto(w1, bw.hiddenInputs);
+    applyInto(bw.hiddenInputs, bw.hiddenOutputs, Activation::Sigmoid, activationPrecision);
+    bw.hiddenOutputs.dotNTInto(w2, bw.finalInputs);
+    applyInto(bw.finalInputs, bw.finalOutputs, Activation::Sigmoid, activationPrecision);
+
+    return bw.finalOutputs;
+}
+
+// One SGD step on a single sample. Returns the network's outputs for the sample from before
+// the update (a reference into the workspace, valid until the next step or forward pass).
+const Matrix<float>& Model::trainLayer(std::span<const float> inputs, int label) {
+    // Every intermediate lives in the workspace, so this does not allocate; the inputs are
+    // read in place
+    Workspace& ws = workspace;
+    std::fill(ws.targets.begin(), ws.targets.end(), 0.1f);
+    ws.targets(label, 0) = 0.99f; // One-hot encoding
+
+    // Make a forward pass - computing hidden and final outputs
+    denseSpan(hiddenNodes, inputNodes, inputHiddenWeights.values(), inputNodes, inputs.data(), nullptr, ws.hiddenOutputs.values(),
+              Activation::Sigmoid, activationPrecision);
+    denseInto(hiddenOutputWeights, ws.hiddenOutputs, ws.finalOutputs, Activation::Sigmoid, activationPrecision);
+
+    // Calculate the output errors
+    ws.targets.subtractInto(ws.finalOutputs, ws.outputErrors);
+    hiddenOutputWeights.gemvTInto(ws.outputErrors, ws.hiddenErrors);
+
+    // Update weights for hidden-to-output: W += lr * scaledErrors * hiddenOutputs^T, in place
+    applyDerivativeInto(ws.finalOutputs, ws.outputGradients, Activation::Sigmoid);
+    ws.outputErrors.hadamardInto(ws.outputGradients, ws.outputGradients); // scaled output errors
+    hiddenOutputWeights.ger(learningRate, ws.outputGradients, ws.hiddenOutputs);
+
+    // Update weights for input-to-hidden: W += lr * scaledErrors * inputs^T, in place
+    applyDerivativeInto(ws.hiddenOutputs, ws.hiddenGradients, Activation::Sigmoid);
+    ws.hiddenErrors.hadamardInto(ws.hiddenGradients, ws.hiddenGradients); // scaled hidden errors
+
+    Gemm::ger<float>(hiddenNodes, inputNodes, learningRate, ws.hiddenGradients.values(), inputs.data(), inputHiddenWeights.values(), inputNodes);
+    return ws.finalOutputs;
 }
 
 float Model::calculateLoss(const std::vector<float>& outputLayer, int trueLabel) {
@@ -375,27 +1067,51 @@ void Model::printConfiguraton() {
         << "Hidden Nodes: " << this->hiddenNodes <<  std::endl
         << "Output Nodes: " << this->outputNodes << std::endl
         << "Epochs: " << this->epochs <<  std::endl
+        << "Batch Size: " << this->batchSize << std::endl
+        << "Threads: " << this->threads << std::endl
+        << "Hogwild: " << (this->hogwild ? "true" : "false") << std::endl
+        << "Post-update Metrics: " << (this->postUpdateMetrics ? "true" : "false") << std::endl
+        << "Activation Precision: " << precisionName(this->activationPrecision) << std::endl
         << "Learning Rate: " << std::fixed << std::setprecision(2) << this->learningRate <<  std::endl
         << "Scaling Factor: " << this->scalingFactor << std::endl
-        << "Shuffle Data: " << (this->shuffleData ? "true" : "false") << std::endl
-        << "Number of Records:" << this->dataRows << std::endl
+        << "Feature Storage: " << featureTypeName(this->featureType) << std::endl
+        << "Data Format: " << dataFormatName(this->dataFormat) << std::endl
+        << "Data Cache: " << (this->dataCache ? "true" : "false") << std::endl
+        << "Streaming: " << (this->streaming ? "true" : "false") << std::endl
+        << "Prefetch Batches: " << (this->prefetcher ? "true" : "false") << std::endl
+        << "Seed: " << this->seed << std::endl
+        << "Evaluate Each Epoch: " << (this->evaluateEachEpoch ? "true" : "false") << std::endl
+        << "Shuffle Data: " << (this->shuffleData ? "true" : "false") << std::endl;
+    // A streamed run only counts its rows as it reads them, and trains on every one
+    std::string records = std::to_string(this->dataRows);
+    std::string trainingRecords = std::to_string(this->splitIndex);
+    if (this->streaming) {
+        records = (this->dataRows > 0 ? records : std::string("all")) + " (streamed)";
+        trainingRecords = "all, no validation rows";
+    }
+    ss << "Number of Records:" << records << std::endl
         << "Validation Split: " << std::fixed << std::setprecision(2)  << this->validationSplit << std::endl
-        << "Training Records:" << this->splitIndex << std::endl;
+        << "Training Records:" << trainingRecords << std::endl
+        << "SIMD: " << Simd::isaName(Simd::activeIsa()) << std::endl;
     std::cout << ss.str();
 }
 
-Matrix<float> Model::forwardPass(std::vector<float>& inputLayer) {
-    Matrix<float> inputs(inputLayer);
-    Matrix<float> hiddenInputs = inputHiddenWeights.dot(inputs);
-    Matrix<float> hiddenOutputs = applyNew(hiddenInputs, sigmoid);
-    Matrix<float> finalInputs = hiddenOutputWeights.dot( hiddenOutputs);
-    Matrix<float> finalOutputs = applyNew(finalInputs, sigmoid);
+// Returns a reference into the workspace, valid until the next forwardPass or trainLayer
+const Matrix<float>& Model::forwardPass(std::span<const float> inputs) {
+    if (inputs.size() != static_cast<size_t>(inputNodes)) {
+        throw std::invalid_argument("forwardPass: input length must match the input nodes");
+    }
+    Workspace& ws = workspace;
+    // Fused product + sigmoid per layer; the pre-activations are never stored
+    denseSpan(hiddenNodes, inputNodes, inputHiddenWeights.values(), inputNodes, inputs.data(), nullptr, ws.hiddenOutputs.values(),
+              Activation::Sigmoid, activationPrecision);
+    denseInto(hiddenOutputWeights, ws.hiddenOutputs, ws.finalOutputs, Activation::Sigmoid, activationPrecision);
 
-    return finalOutputs;
+    return ws.finalOutputs;
 }
 
 void Model::printOutput(std::vector<float>& inputLayer, int index) {
-    Matrix<float> output = forwardPass(inputLayer);
+    const Matrix<float>& output = forwardPass(inputLayer);
     std::cout << "\nOutput nodes for " << index << ":" << std::endl;
     output.print();
 }
@@ -11,12 +11,126 @@
 #include <iomanip>
 #include <iostream>
 #include <vector>
+#include <future>
+#include <memory>
 #include <random>
 #include <stdexcept>
 #include "activation_functions.h"
+#include "batch_prefetcher.h"
+#include "dataset.h"
+#include "random.h"
+#include "thread_pool.h"
 
 
 namespace NeuralNetwork{
+    // Scratch storage for one training sample. Sized once from the layer sizes so that
+    // trainLayer and forwardPass only ever write into existing buffers.
+    struct Workspace {
+        Matrix<float> targets;
+        Matrix<float> hiddenOutputs;
+        Matrix<float> finalOutputs;
+        Matrix<float> outputErrors;
+        Matrix<float> hiddenErrors;
+        Matrix<float> outputGradients;
+        Matrix<float> hiddenGradients;
+        std::vector<float> inputs; // a compact sample converted to float
+        std::vector<float> outputLayer;
+
+        Workspace(int inputNodes, int hiddenNodes, int outputNodes);
+    };
+
+    // Scratch storage for one mini-batch, one sample per row (batch x layer size)
+    struct BatchWorkspace {
+        Matrix<float> inputs;
+        Matrix<float> targets;
+        Matrix<float> hiddenInputs;
+        Matrix<float> hiddenOutputs;
+        Matrix<float> finalInputs;
+        Matrix<float> finalOutputs;
+        Matrix<float> outputErrors;
+        Matrix<float> hiddenErrors;
+        Matrix<float> outputGradients;
+        Matrix<float> hiddenGradients;
+
+        BatchWorkspace(int inputNodes, int hiddenNodes, int outputNodes, size_t batchSize);
+    };
+
+    // Per-thread state for data-parallel training: a workspace for the thread's slice of each
+    // batch and private gradient buffers, so workers never write to shared memory
+    struct WorkerState {
+        BatchWorkspace workspace;
+        Matrix<float> inputHiddenGradient;
+        Matrix<float> hiddenOutputGradient;
+        double busySeconds = 0.0;
+
+        // Per-sample scratch and running metrics for Hogwild training
+        std::vector<float> inputs;
+        std::vector<float> hidden;
+        std::vector<float> hiddenErrors;
+        std::vector<float> outputLayer;
+        std::vector<float> outputErrors;
+        std::vector<float> confidence;
+        float loss = 0.0f;
+        int correct = 0;
+
+        WorkerState(int inputNodes, int hiddenNodes, int outputNodes, size_t batchSize);
+    };
+
+    // A weight matrix shared by Hogwild workers, with every row padded out to its own
+    // cache lines so threads updating neighbouring rows do not false-share
+    struct PaddedWeights {
+        std::vector<float> storage;
+        float* data = nullptr;
+        size_t rows = 0;
+        size_t cols = 0;
+        size_t stride = 0;
+
+        void load(const Matrix<float>& m);
+        void store(Matrix<float>& m) const;
+    };
+
+    // Everything a Model is built from. fromConfigFile fills one from a JSON file; an optional
+    // key that is missing there leaves its field at the default given here.
+    struct ModelConfig {
+        int inputNodes = 0;
+        int hiddenNodes = 0;
+        int outputNodes = 0;
+        float learningRate = 0.3f;
+        float scalingFactor = 1.0f;
+        bool shuffleData = true;
+        float validationSplit = 0.1f;
+        std::string dataFile;
+        size_t dataRows = 0;
+        size_t epochs = 1;
+        size_t batchSize = 1;           // samples per weight update (1 = per-sample SGD)
+        size_t threads = 1;             // training threads (0 = all hardware threads)
+        bool hogwild = false;
+        bool postUpdateMetrics = false; // score with a second forward pass after each update
+        ActivationFunctions::Precision activationPrecision = ActivationFunctions::Precision::Polynomial;
+        FeatureType featureType = FeatureType::Float32;
+        bool dataCache = true;
+        DataFormat dataFormat = DataFormat::Csv;
+        std::string labelsFile;         // IDX only
+        bool streaming = false;
+        size_t shardRows = 4096;
+        size_t shuffleBuffer = 16384;
+        bool prefetchBatches = true;
+        uint64_t seed = 0;
+        bool evaluateEachEpoch = false;
+    };
+
+    // Metrics of one set of weights over a set of samples, from Model::evaluate
+    struct Evaluation {
+        size_t samples = 0;
+        size_t correct = 0;
+        float loss = 0.0f;     // mean cross-entropy per sample
+        float accuracy = 0.0f; // % of samples predicted correctly
+        size_t classes = 0;
+        std::vector<size_t> confusion; // classes x classes counts: row = true label, column = prediction
+        double seconds = 0.0;
+        double samplesPerSecond = 0.0;
+    };
+
     class Model {
         // private
         int inputNodes = 0;
@@ -30,32 +144,83 @@ namespace NeuralNetwork{
         size_t dataRows = 0;
         size_t splitIndex = 0;
         size_t digits = 10;
+        size_t batchSize = 1;
+        size_t threads = 1;
+        bool hogwild = false;
+        bool postUpdateMetrics = false;
+        ActivationFunctions::Precision activationPrecision = ActivationFunctions::Precision::Polynomial;
+        FeatureType featureType = FeatureType::Float32;
+        bool dataCache = true;
+        DataFormat dataFormat = DataFormat::Csv;
+        std::string labelsFile; // IDX only
+        bool streaming = false;
+        size_t shardRows = 4096;
+        size_t shuffleBuffer = 16384;
+        static constexpr size_t streamRingShards = 4;
+        size_t progressOffset = 0; // rows of the epoch trained before the current chunk
+        double parallelSeconds = 0.0;
 
-        std::mt19937 gen; // Random number generator
+        uint64_t seed = 0;
+        Xoshiro256 weightRng;  // weight initialisation
+        Xoshiro256 shuffleRng; // row order, and the seeds of streamed epochs
         Matrix<float> inputHiddenWeights;
         Matrix<float> hiddenOutputWeights;
         std::string dataFile;
-        std::vector<std::vector<float>> data;
-        std::vector<std::vector<float>> trainingData;
-        std::vector<std::vector<float>> validationData;
-        std::vector<int> labels;   
-        std::vector<int> trainingLabels;   
-        std::vector<int> validationLabels;   
+        Dataset dataset;
+        std::vector<size_t> order; // row indices: training rows first, then validation rows
+        DatasetView trainingSet;
+        DatasetView validationSet;
         std::vector<float> confidenceChanges;
+        Workspace workspace;
+        BatchWorkspace batchWorkspace;
+        std::unique_ptr<ThreadPool> pool;
+        std::unique_ptr<BatchPrefetcher> prefetcher;
+        bool evaluateEachEpoch = false;
+        static constexpr size_t evaluationBatch = 256;
+        // Weights as they were at the end of the epoch being evaluated in the background
+        Matrix<float> snapshotInputHidden{0, 0};
+        Matrix<float> snapshotHiddenOutput{0, 0};
+        std::future<Evaluation> pendingEvaluation;
+        std::vector<WorkerState> workers;
+        PaddedWeights sharedInputHidden;
+        PaddedWeights sharedHiddenOutput;
 
         //methods        
         float calculateLoss(const std::vector<float>& outputLayer, int trueLabel);
         int getPredictedLabel(const std::vector<float>& outputLayer);
-        Matrix<float> forwardPass(std::vector<float>& inputLayer);
+        const Matrix<float>& forwardPass(std::span<const float> inputs);
         void initializeWeights(Matrix<float>& matrix, int nodesInPreviousLayer);
-        void shuffle();
+        void shuffle(size_t count);
         void splitData();
-        void trainLayer(const std::vector<float>& inputLayer, const std::vector<float>& targetLayer);
+        const Matrix<float>& trainLayer(std::span<const float> inputs, int label);
+        void trainEpoch(size_t iter, bool showProgress, float& totalLoss, int& correctPredictions);
+        void trainEpochHogwild(float& totalLoss, int& correctPredictions);
+        size_t trainEpochStreaming(size_t iter, bool showProgress, float& totalLoss, int& correctPredictions);
+        void hogwildStep(WorkerState& worker, const float* inputs, int label);
+        std::pair<float, float> measureLoss();
+        bool takePrefetchedBatch(size_t first, size_t count);
+        void backpropagate(BatchWorkspace& bw);
+        const Matrix<float>& trainBatch(BatchWorkspace& bw);
+        void trainBatchParallel(size_t first, size_t count);
+        static size_t sliceStart(size_t first, size_t count, size_t active, size_t t);
+        const Matrix<float>& forwardBatch(BatchWorkspace& bw);
+        const Matrix<float>& forwardBatch(BatchWorkspace& bw, const Matrix<float>& w1, const Matrix<float>& w2) const;
+        Evaluation evaluateWith(const DatasetView& samples, const Matrix<float>& w1, const Matrix<float>& w2, ThreadPool* threadPool);
+        void evaluateEpoch(size_t iter);
+        void scoreBatch(const Matrix<float>& outputs, size_t first, size_t iter, bool showProgress, float& totalLoss, int& correctPredictions);
+        void scoreOutput(const std::vector<float>& outputLayer, int label, float& totalLoss, int& correctPredictions);
+        void printProgress(size_t iter, size_t i);
         
     public:
-        Model(int inputNodes, int hiddenNodes, int outputNodes, float learningRate, float scalingFactor, bool shuffleData, float validationSplit, std::string dataFile, size_t dataRows);
+        explicit Model(const ModelConfig& config);
         static Model fromConfigFile(const std::string& configFileLocation);
         void train(bool showProgress);
+        void benchmarkHogwild(size_t benchmarkEpochs);
+        // Batched inference with the current weights over samples (the validation rows by
+        // default), split over the training threads
+        Evaluation evaluate(const DatasetView& samples);
+        Evaluation evaluate() { return evaluate(validationSet); }
+        static void printEvaluation(const Evaluation& evaluation, const std::string& title, bool confusion);
         void printWeights();
         void printConfiguraton();
         void printOutput(std::vector<float>& inputLayer, int index);
@@ -0,0 +1,86 @@
+//
+//  random.h
+//  NeuralNetwork
+//
+//  Seeded, reproducible random numbers. Xoshiro256** (Blackman and Vigna, 2018) is a small,
+//  fast generator with 256 bits of state that passes BigCrush; SplitMix64 expands a 64-bit
+//  seed into that state. It meets the standard UniformRandomBitGenerator requirements, so
+//  it drives std::shuffle and the <random> distributions directly.
+//
+//  One seed gives any number of independent streams: stream k starts 2^128 * k draws into
+//  the seed's sequence (the generator's jump), so streams never overlap. Each consumer -
+//  weight initialisation, the shuffles - owns its own stream and never shares a generator
+//  or takes a lock.
+//
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <limits>
+
+namespace NeuralNetwork{
+    // One SplitMix64 step: advances state and returns a well-mixed 64-bit value
+    inline uint64_t splitMix64(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    class Xoshiro256 {
+        uint64_t s[4];
+
+        static uint64_t rotl(uint64_t x, int k) {
+            return (x << k) | (x >> (64 - k));
+        }
+
+    public:
+        using result_type = uint64_t;
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        // Stream `stream` of the sequence for `seed`
+        explicit Xoshiro256(uint64_t seed = 0, uint64_t stream = 0) {
+            uint64_t state = seed;
+            for (uint64_t& word : s) {
+                word = splitMix64(state);
+            }
+            for (uint64_t k = 0; k < stream; ++k) {
+                jump();
+            }
+        }
+
+        result_type operator()() {
+            uint64_t result = rotl(s[1] * 5, 7) * 9;
+            uint64_t t = s[1] << 17;
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = rotl(s[3], 45);
+            return result;
+        }
+
+        // Advance by 2^128 draws, the start of the next stream
+        void jump() {
+            static constexpr uint64_t polynomial[4] = {0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull, 0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull};
+            uint64_t jumped[4] = {0, 0, 0, 0};
+            for (uint64_t word : polynomial) {
+                for (int bit = 0; bit < 64; ++bit) {
+                    if (word & (uint64_t(1) << bit)) {
+                        for (int i = 0; i < 4; ++i) {
+                            jumped[i] ^= s[i];
+                        }
+                    }
+                    (*this)();
+                }
+            }
+            for (int i = 0; i < 4; ++i) {
+                s[i] = jumped[i];
+            }
+        }
+    };
+}
+
+#endif // RANDOM_H
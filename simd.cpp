@@ -0,0 +1,138 @@
+//
+//  simd.cpp
+//  NeuralNetwork
+//
+//  Portable scalar kernels and the one-time CPUID dispatch.
+//
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "simd.h"
+
+namespace NeuralNetwork{
+namespace Simd {
+namespace {
+    struct ScalarOps {
+        using Vec = float;
+        static constexpr size_t width = 1;
+
+        static Vec load(const float* p) { return *p; }
+        static void store(float* p, Vec v) { *p = v; }
+        static Vec set1(float s) { return s; }
+        static Vec add(Vec a, Vec b) { return a + b; }
+        static Vec sub(Vec a, Vec b) { return a - b; }
+        static Vec mul(Vec a, Vec b) { return a * b; }
+        static Vec zero() { return 0.0f; }
+        static Vec fma(Vec a, Vec b, Vec c) { return a * b + c; }
+        static Vec div(Vec a, Vec b) { return a / b; }
+        static Vec max(Vec a, Vec b) { return (a > b) ? a : b; }
+        static Vec min(Vec a, Vec b) { return (a < b) ? a : b; }
+        static Vec round(Vec v) { return std::nearbyint(v); }
+        static Vec floor(Vec v) { return std::floor(v); }
+        static Vec gather(const float* base, Vec index) { return base[static_cast<size_t>(index)]; }
+        // 2^n for integral n in the normal exponent range, built directly in the exponent bits
+        static Vec pow2n(Vec n) {
+            uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(n) + 127) << 23;
+            float result;
+            std::memcpy(&result, &bits, sizeof(result));
+            return result;
+        }
+
+        using Mask = bool;
+        static Mask less(Vec a, Vec b) { return a < b; }
+        static Vec select(Mask m, Vec ifTrue, Vec ifFalse) { return m ? ifTrue : ifFalse; }
+        static float reduce(Vec v) { return v; }
+    };
+}
+}
+}
+
+#include "simd_kernels.h"
+
+namespace NeuralNetwork{
+namespace Simd {
+    Kernels scalarKernels() {
+        return makeKernels<ScalarOps>(Isa::Scalar);
+    }
+
+    // __builtin_cpu_supports reads CPUID and also checks that the OS saves the wider register
+    // state (XGETBV)
+    Isa supportedIsa() {
+#if defined(NN_SIMD_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("fma")) {
+            return Isa::AVX512;
+        }
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return Isa::AVX2;
+        }
+        if (__builtin_cpu_supports("sse4.2")) {
+            return Isa::SSE42;
+        }
+#endif
+        return Isa::Scalar;
+    }
+
+    // NN_SIMD lets the user cap the instruction set below what the CPU supports
+    static Isa requestedIsa(Isa detected) {
+        const char* env = std::getenv("NN_SIMD");
+        if (env == nullptr) {
+            return detected;
+        }
+
+        Isa requested = detected;
+        if (std::strcmp(env, "scalar") == 0) {
+            requested = Isa::Scalar;
+        } else if (std::strcmp(env, "sse4.2") == 0) {
+            requested = Isa::SSE42;
+        } else if (std::strcmp(env, "avx2") == 0) {
+            requested = Isa::AVX2;
+        } else if (std::strcmp(env, "avx512") == 0) {
+            requested = Isa::AVX512;
+        }
+        return (requested < detected) ? requested : detected;
+    }
+
+    static Kernels selectKernels() {
+        return kernelsFor(requestedIsa(supportedIsa()));
+    }
+
+    Kernels kernelsFor(Isa isa) {
+        switch (isa) {
+#if defined(NN_SIMD_X86)
+            case Isa::AVX512:
+                return avx512Kernels();
+            case Isa::AVX2:
+                return avx2Kernels();
+            case Isa::SSE42:
+                return sse42Kernels();
+#endif
+            default:
+                return scalarKernels();
+        }
+    }
+
+    const Kernels& kernels() {
+        static const Kernels selected = selectKernels();
+        return selected;
+    }
+
+    Isa activeIsa() {
+        return kernels().isa;
+    }
+
+    const char* isaName(Isa isa) {
+        switch (isa) {
+            case Isa::AVX512:
+                return "AVX-512";
+            case Isa::AVX2:
+                return "AVX2";
+            case Isa::SSE42:
+                return "SSE4.2";
+            default:
+                return "scalar";
+        }
+    }
+}
+}
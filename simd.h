@@ -0,0 +1,86 @@
+//
+//  simd.h
+//  NeuralNetwork
+//
+//  Explicit SIMD kernels for contiguous float spans, selected once at startup.
+//
+//  Each instruction set lives in its own translation unit (simd_sse42.cpp, simd_avx2.cpp,
+//  simd_avx512.cpp) compiled with the matching -m flags, so the rest of the program stays
+//  baseline x86-64 and one binary runs on any machine. The best table the CPU (and OS)
+//  supports is chosen via CPUID the first time kernels() is called. Setting the NN_SIMD
+//  environment variable to scalar, sse4.2, avx2 or avx512 caps the choice, which is handy
+//  for comparing paths on one box.
+//
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+
+namespace NeuralNetwork{
+namespace Simd {
+    enum class Isa { Scalar, SSE42, AVX2, AVX512 };
+
+    // Function table for one instruction set. Outputs may alias inputs (in-place use).
+    struct Kernels {
+        Isa isa;
+        // out = a + b
+        void (*add)(const float* a, const float* b, float* out, size_t n);
+        // out = a - b
+        void (*sub)(const float* a, const float* b, float* out, size_t n);
+        // out = a * b (element-wise)
+        void (*mul)(const float* a, const float* b, float* out, size_t n);
+        // out = a * s
+        void (*scale)(const float* a, float s, float* out, size_t n);
+        // returns sum(a * b)
+        float (*dot)(const float* a, const float* b, size_t n);
+        // y += alpha * x
+        void (*axpy)(float alpha, const float* x, float* y, size_t n);
+
+        // Element-wise activations, out = f(in). sigmoid and tanh use a vectorised Cephes
+        // style exp/tanh that stays within a couple of ulp of libm on every instruction set.
+        // The paths are not bit-identical: AVX2 and AVX-512 fuse each multiply-add, scalar
+        // and SSE4.2 round after each step, and the GEMM kernels sum in different orders per
+        // width. A seeded training run therefore only repeats exactly on the same
+        // instruction set; a different CPU or NN_SIMD setting gives slightly different weights.
+        void (*sigmoid)(const float* in, float* out, size_t n);
+        void (*tanh)(const float* in, float* out, size_t n);
+        void (*relu)(const float* in, float* out, size_t n);
+        // out = x > 0 ? x : slope * x, for 0 <= slope <= 1
+        void (*leakyRelu)(const float* in, float slope, float* out, size_t n);
+        // Piecewise-linear interpolation in a table of intervals + 2 samples, where
+        // table[i] = f(lo + i / invStep) and the last sample repeats the one before it.
+        // Inputs outside the table clamp to its end points.
+        void (*lookup)(const float* table, size_t intervals, float lo, float invStep, const float* in, float* out, size_t n);
+
+        // GEMM register tile over the packed panels of gemm.h:
+        // C(mr x nr) = alpha * Apanel(kc x gemmMR) * Bpanel(kc x gemmNR) + beta * C.
+        // The tile shape is fixed per instruction set; gemmTile is null for the scalar
+        // table, which uses the portable template micro-kernel instead.
+        size_t gemmMR;
+        size_t gemmNR;
+        void (*gemmTile)(size_t kc, const float* a, const float* b, float alpha, float beta, float* c, size_t ldc, size_t mr, size_t nr);
+    };
+
+    // The table in use for this process
+    const Kernels& kernels();
+
+    // The instruction set behind kernels(), and a printable name for it
+    Isa activeIsa();
+    const char* isaName(Isa isa);
+
+    // The highest instruction set this CPU and OS can run, whatever NN_SIMD asks for, and the
+    // table for any instruction set up to it - for checking every path on one machine
+    Isa supportedIsa();
+    Kernels kernelsFor(Isa isa);
+
+    // Per-ISA tables; only present on x86 builds (see CMakeLists.txt)
+    Kernels scalarKernels();
+#if defined(NN_SIMD_X86)
+    Kernels sse42Kernels();
+    Kernels avx2Kernels();
+    Kernels avx512Kernels();
+#endif
+}
+}
+
+#endif // SIMD_H
@@ -0,0 +1,63 @@
+//
+//  simd_avx2.cpp
+//  NeuralNetwork
+//
+//  AVX2 + FMA kernels (8 floats per register). Compiled with -mavx2 -mfma.
+//
+#include <immintrin.h>
+#include "simd.h"
+
+namespace NeuralNetwork{
+namespace Simd {
+namespace {
+    struct Avx2Ops {
+        using Vec = __m256;
+        static constexpr size_t width = 8;
+
+        // 6 x 16 tile: 12 accumulators of the 16 ymm registers
+        static constexpr size_t gemmRows = 6;
+
+        static Vec load(const float* p) { return _mm256_loadu_ps(p); }
+        static void store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+        static Vec set1(float s) { return _mm256_set1_ps(s); }
+        static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+        static Vec zero() { return _mm256_setzero_ps(); }
+        static Vec fma(Vec a, Vec b, Vec c) { return _mm256_fmadd_ps(a, b, c); }
+        static Vec div(Vec a, Vec b) { return _mm256_div_ps(a, b); }
+        static Vec max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+        static Vec min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+        static Vec round(Vec v) { return _mm256_round_ps(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        static Vec floor(Vec v) { return _mm256_floor_ps(v); }
+        // base[index[j]] for non-negative integral indices
+        static Vec gather(const float* base, Vec index) { return _mm256_i32gather_ps(base, _mm256_cvttps_epi32(index), 4); }
+        // 2^n for integral n in the normal exponent range, built directly in the exponent bits
+        static Vec pow2n(Vec n) {
+            return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23));
+        }
+
+        using Mask = __m256;
+        static Mask less(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static Vec select(Mask m, Vec ifTrue, Vec ifFalse) { return _mm256_blendv_ps(ifFalse, ifTrue, m); }
+        static float reduce(Vec v) {
+            __m128 sums = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+            __m128 shuf = _mm_movehdup_ps(sums);
+            sums = _mm_add_ps(sums, shuf);
+            shuf = _mm_movehl_ps(shuf, sums);
+            return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+        }
+    };
+}
+}
+}
+
+#include "simd_kernels.h"
+
+namespace NeuralNetwork{
+namespace Simd {
+    Kernels avx2Kernels() {
+        return makeKernels<Avx2Ops>(Isa::AVX2);
+    }
+}
+}
@@ -0,0 +1,68 @@
+//
+//  simd_avx512.cpp
+//  NeuralNetwork
+//
+//  AVX-512F kernels (16 floats per register). Compiled with -mavx512f -mfma.
+//
+// GCC 12's AVX-512 header builds its "undefined" vectors by self-initialisation, which
+// -Wuninitialized reports wherever such an intrinsic is inlined; newer GCC does not
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#else
+#include <immintrin.h>
+#endif
+#include "simd.h"
+
+namespace NeuralNetwork{
+namespace Simd {
+namespace {
+    struct Avx512Ops {
+        using Vec = __m512;
+        static constexpr size_t width = 16;
+
+        // 12 x 32 tile: 24 accumulators of the 32 zmm registers
+        static constexpr size_t gemmRows = 12;
+
+        static Vec load(const float* p) { return _mm512_loadu_ps(p); }
+        static void store(float* p, Vec v) { _mm512_storeu_ps(p, v); }
+        static Vec set1(float s) { return _mm512_set1_ps(s); }
+        static Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+        static Vec zero() { return _mm512_setzero_ps(); }
+        static Vec fma(Vec a, Vec b, Vec c) { return _mm512_fmadd_ps(a, b, c); }
+        static Vec div(Vec a, Vec b) { return _mm512_div_ps(a, b); }
+        static Vec max(Vec a, Vec b) { return _mm512_max_ps(a, b); }
+        static Vec min(Vec a, Vec b) { return _mm512_min_ps(a, b); }
+        static Vec round(Vec v) { return _mm512_roundscale_ps(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        static Vec floor(Vec v) { return _mm512_roundscale_ps(v, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+        // base[index[j]] for non-negative integral indices
+        static Vec gather(const float* base, Vec index) { return _mm512_i32gather_ps(_mm512_cvttps_epi32(index), base, 4); }
+        // 2^n for integral n in the normal exponent range, built directly in the exponent bits
+        static Vec pow2n(Vec n) {
+            return _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127)), 23));
+        }
+
+        // Comparisons produce a k-register bit mask rather than a vector
+        using Mask = __mmask16;
+        static Mask less(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static Vec select(Mask m, Vec ifTrue, Vec ifFalse) { return _mm512_mask_blend_ps(m, ifFalse, ifTrue); }
+        static float reduce(Vec v) { return _mm512_reduce_add_ps(v); }
+    };
+}
+}
+}
+
+#include "simd_kernels.h"
+
+namespace NeuralNetwork{
+namespace Simd {
+    Kernels avx512Kernels() {
+        return makeKernels<Avx512Ops>(Isa::AVX512);
+    }
+}
+}
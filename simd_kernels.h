@@ -0,0 +1,289 @@
+//
+//  simd_kernels.h
+//  NeuralNetwork
+//
+//  Kernel bodies shared by every instruction set. A translation unit defines an Ops traits
+//  struct for its vector type (width, load, store, arithmetic) and includes this file;
+//  makeKernels<Ops>() then builds its Kernels table.
+//
+//  Everything here sits in an anonymous namespace and avoids inline library templates, so
+//  no function compiled with AVX flags can be merged by the linker into baseline code.
+//
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include "simd.h"
+
+namespace NeuralNetwork{
+namespace Simd {
+namespace {
+    template <typename V>
+    void addKernel(const float* a, const float* b, float* out, size_t n) {
+        size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            V::store(out + i, V::add(V::load(a + i), V::load(b + i)));
+        }
+        for (; i < n; ++i) {
+            out[i] = a[i] + b[i];
+        }
+    }
+
+    template <typename V>
+    void subKernel(const float* a, const float* b, float* out, size_t n) {
+        size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            V::store(out + i, V::sub(V::load(a + i), V::load(b + i)));
+        }
+        for (; i < n; ++i) {
+            out[i] = a[i] - b[i];
+        }
+    }
+
+    template <typename V>
+    void mulKernel(const float* a, const float* b, float* out, size_t n) {
+        size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            V::store(out + i, V::mul(V::load(a + i), V::load(b + i)));
+        }
+        for (; i < n; ++i) {
+            out[i] = a[i] * b[i];
+        }
+    }
+
+    template <typename V>
+    void scaleKernel(const float* a, float s, float* out, size_t n) {
+        const typename V::Vec vs = V::set1(s);
+        size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            V::store(out + i, V::mul(V::load(a + i), vs));
+        }
+        for (; i < n; ++i) {
+            out[i] = a[i] * s;
+        }
+    }
+
+    // Four independent accumulators hide the FMA latency; the reduction order differs from a
+    // plain left-to-right sum, so results can differ from the scalar loop in the last bits
+    template <typename V>
+    float dotKernel(const float* a, const float* b, size_t n) {
+        typename V::Vec acc0 = V::zero();
+        typename V::Vec acc1 = V::zero();
+        typename V::Vec acc2 = V::zero();
+        typename V::Vec acc3 = V::zero();
+        size_t i = 0;
+        for (; i + 4 * V::width <= n; i += 4 * V::width) {
+            acc0 = V::fma(V::load(a + i), V::load(b + i), acc0);
+            acc1 = V::fma(V::load(a + i + V::width), V::load(b + i + V::width), acc1);
+            acc2 = V::fma(V::load(a + i + 2 * V::width), V::load(b + i + 2 * V::width), acc2);
+            acc3 = V::fma(V::load(a + i + 3 * V::width), V::load(b + i + 3 * V::width), acc3);
+        }
+        for (; i + V::width <= n; i += V::width) {
+            acc0 = V::fma(V::load(a + i), V::load(b + i), acc0);
+        }
+        float sum = V::reduce(V::add(V::add(acc0, acc1), V::add(acc2, acc3)));
+        for (; i < n; ++i) {
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+    template <typename V>
+    void axpyKernel(float alpha, const float* x, float* y, size_t n) {
+        const typename V::Vec va = V::set1(alpha);
+        size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            V::store(y + i, V::fma(va, V::load(x + i), V::load(y + i)));
+        }
+        for (; i < n; ++i) {
+            y[i] += alpha * x[i];
+        }
+    }
+
+    // e^x as 2^n * e^r with n = round(x / ln 2) and |r| <= ln 2 / 2 (Cephes expf). ln 2 is
+    // split in two so r keeps full precision, and x is clamped so 2^n stays a normal float.
+    template <typename V>
+    typename V::Vec expVec(typename V::Vec x) {
+        x = V::min(V::max(x, V::set1(-87.3f)), V::set1(88.3f));
+        const typename V::Vec n = V::round(V::mul(x, V::set1(1.44269504088896341f)));
+        x = V::sub(x, V::mul(n, V::set1(0.693359375f)));
+        x = V::sub(x, V::mul(n, V::set1(-2.12194440e-4f)));
+
+        typename V::Vec p = V::set1(1.9875691500e-4f);
+        p = V::fma(p, x, V::set1(1.3981999507e-3f));
+        p = V::fma(p, x, V::set1(8.3334519073e-3f));
+        p = V::fma(p, x, V::set1(4.1665795894e-2f));
+        p = V::fma(p, x, V::set1(1.6666665459e-1f));
+        p = V::fma(p, x, V::set1(5.0000001201e-1f));
+        p = V::fma(p, V::mul(x, x), V::add(x, V::set1(1.0f)));
+        return V::mul(p, V::pow2n(n));
+    }
+
+    template <typename V>
+    typename V::Vec sigmoidVec(typename V::Vec x) {
+        const typename V::Vec one = V::set1(1.0f);
+        return V::div(one, V::add(one, expVec<V>(V::sub(V::zero(), x))));
+    }
+
+    // tanh(x) = 1 - 2 / (e^2x + 1), which loses relative precision near zero, so |x| < 0.625
+    // uses the Cephes odd polynomial instead
+    template <typename V>
+    typename V::Vec tanhVec(typename V::Vec x) {
+        const typename V::Vec one = V::set1(1.0f);
+        const typename V::Vec large = V::sub(one, V::div(V::set1(2.0f), V::add(expVec<V>(V::add(x, x)), one)));
+
+        const typename V::Vec z = V::mul(x, x);
+        typename V::Vec p = V::set1(-5.70498872745e-3f);
+        p = V::fma(p, z, V::set1(2.06390887954e-2f));
+        p = V::fma(p, z, V::set1(-5.37397155531e-2f));
+        p = V::fma(p, z, V::set1(1.33314422036e-1f));
+        p = V::fma(p, z, V::set1(-3.33332819422e-1f));
+        const typename V::Vec small = V::fma(V::mul(p, z), x, x);
+
+        return V::select(V::less(z, V::set1(0.390625f)), small, large);
+    }
+
+    // out = f(in) a register at a time; the tail goes through a padded stack buffer so
+    // every element sees exactly the same arithmetic
+    template <typename V, typename F>
+    void mapKernel(const float* in, float* out, size_t n, F f) {
+        size_t i = 0;
+        for (; i + V::width <= n; i += V::width) {
+            V::store(out + i, f(V::load(in + i)));
+        }
+        if (i < n) {
+            float tail[V::width] = {};
+            for (size_t j = 0; i + j < n; ++j) {
+                tail[j] = in[i + j];
+            }
+            V::store(tail, f(V::load(tail)));
+            for (size_t j = 0; i + j < n; ++j) {
+                out[i + j] = tail[j];
+            }
+        }
+    }
+
+    template <typename V>
+    void sigmoidKernel(const float* in, float* out, size_t n) {
+        mapKernel<V>(in, out, n, [](typename V::Vec x) { return sigmoidVec<V>(x); });
+    }
+
+    template <typename V>
+    void tanhKernel(const float* in, float* out, size_t n) {
+        mapKernel<V>(in, out, n, [](typename V::Vec x) { return tanhVec<V>(x); });
+    }
+
+    template <typename V>
+    void reluKernel(const float* in, float* out, size_t n) {
+        mapKernel<V>(in, out, n, [](typename V::Vec x) { return V::max(x, V::zero()); });
+    }
+
+    // For slope <= 1, max(x, slope * x) picks x when x > 0 and slope * x otherwise
+    template <typename V>
+    void leakyReluKernel(const float* in, float slope, float* out, size_t n) {
+        const typename V::Vec vs = V::set1(slope);
+        mapKernel<V>(in, out, n, [vs](typename V::Vec x) { return V::max(x, V::mul(vs, x)); });
+    }
+
+    template <typename V>
+    void lookupKernel(const float* table, size_t intervals, float lo, float invStep, const float* in, float* out, size_t n) {
+        const typename V::Vec vlo = V::set1(lo);
+        const typename V::Vec vinv = V::set1(invStep);
+        const typename V::Vec last = V::set1(static_cast<float>(intervals));
+        mapKernel<V>(in, out, n, [=](typename V::Vec x) {
+            // Fractional table position, clamped so index + 1 stays inside the padded table
+            const typename V::Vec t = V::min(V::max(V::mul(V::sub(x, vlo), vinv), V::zero()), last);
+            const typename V::Vec index = V::floor(t);
+            const typename V::Vec frac = V::sub(t, index);
+            const typename V::Vec a = V::gather(table, index);
+            const typename V::Vec b = V::gather(table + 1, index);
+            return V::fma(frac, V::sub(b, a), a);
+        });
+    }
+
+    // gemmRows x (2 * width) register tile; accumulators stay in registers for the whole
+    // kc loop and C is touched once at the end. Edge tiles go through a stack buffer.
+    template <typename V>
+    void gemmTileKernel(size_t kc, const float* a, const float* b, float alpha, float beta, float* c, size_t ldc, size_t mr, size_t nr) {
+        constexpr size_t MR = V::gemmRows;
+        constexpr size_t W = V::width;
+        constexpr size_t NR = 2 * W;
+
+        typename V::Vec acc0[MR];
+        typename V::Vec acc1[MR];
+        for (size_t i = 0; i < MR; ++i) {
+            acc0[i] = V::zero();
+            acc1[i] = V::zero();
+        }
+
+        for (size_t p = 0; p < kc; ++p) {
+            const typename V::Vec b0 = V::load(b + p * NR);
+            const typename V::Vec b1 = V::load(b + p * NR + W);
+            const float* ap = a + p * MR;
+            for (size_t i = 0; i < MR; ++i) {
+                const typename V::Vec ai = V::set1(ap[i]);
+                acc0[i] = V::fma(ai, b0, acc0[i]);
+                acc1[i] = V::fma(ai, b1, acc1[i]);
+            }
+        }
+
+        const typename V::Vec va = V::set1(alpha);
+        if (mr == MR && nr == NR) {
+            const typename V::Vec vb = V::set1(beta);
+            for (size_t i = 0; i < MR; ++i) {
+                float* ci = c + i * ldc;
+                if (beta == 0.0f) {
+                    // Do not read C when beta is zero (it may be uninitialised or NaN)
+                    V::store(ci, V::mul(va, acc0[i]));
+                    V::store(ci + W, V::mul(va, acc1[i]));
+                } else {
+                    V::store(ci, V::fma(va, acc0[i], V::mul(vb, V::load(ci))));
+                    V::store(ci + W, V::fma(va, acc1[i], V::mul(vb, V::load(ci + W))));
+                }
+            }
+            return;
+        }
+
+        float tile[MR * NR];
+        for (size_t i = 0; i < MR; ++i) {
+            V::store(tile + i * NR, V::mul(va, acc0[i]));
+            V::store(tile + i * NR + W, V::mul(va, acc1[i]));
+        }
+        for (size_t i = 0; i < mr; ++i) {
+            float* ci = c + i * ldc;
+            for (size_t j = 0; j < nr; ++j) {
+                ci[j] = (beta == 0.0f) ? tile[i * NR + j] : beta * ci[j] + tile[i * NR + j];
+            }
+        }
+    }
+
+    template <typename V>
+    Kernels makeKernels(Isa isa) {
+        Kernels k;
+        k.isa = isa;
+        k.add = addKernel<V>;
+        k.sub = subKernel<V>;
+        k.mul = mulKernel<V>;
+        k.scale = scaleKernel<V>;
+        k.dot = dotKernel<V>;
+        k.axpy = axpyKernel<V>;
+        k.sigmoid = sigmoidKernel<V>;
+        k.tanh = tanhKernel<V>;
+        k.relu = reluKernel<V>;
+        k.leakyRelu = leakyReluKernel<V>;
+        k.lookup = lookupKernel<V>;
+        if constexpr (V::width > 1) {
+            k.gemmMR = V::gemmRows;
+            k.gemmNR = 2 * V::width;
+            k.gemmTile = gemmTileKernel<V>;
+        } else {
+            k.gemmMR = 0;
+            k.gemmNR = 0;
+            k.gemmTile = nullptr;
+        }
+        return k;
+    }
+}
+}
+}
+
+#endif // SIMD_KERNELS_H
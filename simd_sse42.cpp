@@ -0,0 +1,66 @@
+//
+//  simd_sse42.cpp
+//  NeuralNetwork
+//
+//  SSE4.2 kernels (4 floats per register). Compiled with -msse4.2.
+//
+#include <immintrin.h>
+#include "simd.h"
+
+namespace NeuralNetwork{
+namespace Simd {
+namespace {
+    struct Sse42Ops {
+        using Vec = __m128;
+        static constexpr size_t width = 4;
+
+        // 6 x 8 tile: 12 accumulators of the 16 xmm registers
+        static constexpr size_t gemmRows = 6;
+
+        static Vec load(const float* p) { return _mm_loadu_ps(p); }
+        static void store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+        static Vec set1(float s) { return _mm_set1_ps(s); }
+        static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+        static Vec zero() { return _mm_setzero_ps(); }
+        static Vec fma(Vec a, Vec b, Vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        static Vec div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+        static Vec max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+        static Vec min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+        static Vec round(Vec v) { return _mm_round_ps(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        static Vec floor(Vec v) { return _mm_floor_ps(v); }
+        // base[index[j]] for non-negative integral indices; SSE has no gather instruction
+        static Vec gather(const float* base, Vec index) {
+            alignas(16) int i[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(i), _mm_cvttps_epi32(index));
+            return _mm_setr_ps(base[i[0]], base[i[1]], base[i[2]], base[i[3]]);
+        }
+        // 2^n for integral n in the normal exponent range, built directly in the exponent bits
+        static Vec pow2n(Vec n) {
+            return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(n), _mm_set1_epi32(127)), 23));
+        }
+
+        using Mask = __m128;
+        static Mask less(Vec a, Vec b) { return _mm_cmplt_ps(a, b); }
+        static Vec select(Mask m, Vec ifTrue, Vec ifFalse) { return _mm_blendv_ps(ifFalse, ifTrue, m); }
+        static float reduce(Vec v) {
+            Vec shuf = _mm_movehdup_ps(v);
+            Vec sums = _mm_add_ps(v, shuf);
+            shuf = _mm_movehl_ps(shuf, sums);
+            return _mm_cvtss_f32(_mm_add_ss(sums, shuf));
+        }
+    };
+}
+}
+}
+
+#include "simd_kernels.h"
+
+namespace NeuralNetwork{
+namespace Simd {
+    Kernels sse42Kernels() {
+        return makeKernels<Sse42Ops>(Isa::SSE42);
+    }
+}
+}
@@ -0,0 +1,109 @@
+//
+//  thread_pool.cpp
+//  NeuralNetwork
+//
+#include "thread_pool.h"
+
+namespace NeuralNetwork{
+ThreadPool::ThreadPool(size_t threads) {
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// Claim and run tasks until none are left. A task that throws does not stop the others; the
+// first exception is kept for dispatch to rethrow once every task has finished.
+void ThreadPool::drainTasks() {
+    size_t task;
+    while ((task = nextTask.fetch_add(1, std::memory_order_relaxed)) < jobTasks) {
+        try {
+            job(jobContext, task);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+}
+
+void ThreadPool::workerLoop() {
+    size_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        drainTasks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --busyWorkers;
+        }
+        finished.notify_one();
+    }
+}
+
+void ThreadPool::dispatch(size_t tasks, void (*fn)(void*, size_t), void* context) {
+    if (tasks == 0) {
+        return;
+    }
+    if (workers.empty() || tasks == 1) {
+        // Nothing to hand off - run inline, with the same exception semantics
+        std::exception_ptr failure;
+        for (size_t i = 0; i < tasks; ++i) {
+            try {
+                fn(context, i);
+            } catch (...) {
+                if (!failure) {
+                    failure = std::current_exception();
+                }
+            }
+        }
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = fn;
+        jobContext = context;
+        jobTasks = tasks;
+        nextTask.store(0, std::memory_order_relaxed);
+        busyWorkers = workers.size();
+        ++generation;
+    }
+    wake.notify_all();
+
+    // The caller works too, then waits for the workers to check in - even when a task has
+    // failed, as the others may still be using the caller's context
+    drainTasks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return busyWorkers == 0; });
+    if (error) {
+        std::exception_ptr failure = error;
+        error = nullptr;
+        lock.unlock();
+        std::rethrow_exception(failure);
+    }
+}
+}
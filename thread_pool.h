@@ -0,0 +1,61 @@
+//
+//  thread_pool.h
+//  NeuralNetwork
+//
+//  A fixed set of worker threads for fork-join parallel loops. run(tasks, task) calls
+//  task(0) ... task(tasks - 1) across the workers and the calling thread, and returns once
+//  every call has finished. Tasks are handed out dynamically, so task i must not assume it
+//  runs on any particular thread - per-task state should be indexed by i. If tasks throw,
+//  the rest still run and run() rethrows the first exception once all of them are done.
+//
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NeuralNetwork{
+    class ThreadPool {
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable finished;
+
+        // The job currently being run; guarded by mutex except for the atomics
+        void (*job)(void* context, size_t task) = nullptr;
+        void* jobContext = nullptr;
+        size_t jobTasks = 0;
+        size_t generation = 0;
+        size_t busyWorkers = 0;
+        bool stopping = false;
+        std::atomic<size_t> nextTask{0};
+        std::exception_ptr error; // the first exception a task of the current job threw
+
+        void workerLoop();
+        void drainTasks();
+        void dispatch(size_t tasks, void (*fn)(void*, size_t), void* context);
+
+    public:
+        // threads counts the calling thread, so ThreadPool(1) starts no extra threads
+        explicit ThreadPool(size_t threads);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        size_t size() const { return workers.size() + 1; }
+
+        // Type-erased through a plain function pointer so running a job never allocates
+        template <typename Task>
+        void run(size_t tasks, Task& task) {
+            dispatch(tasks, [](void* context, size_t i) { (*static_cast<Task*>(context))(i); }, &task);
+        }
+    };
+}
+
+#endif // THREAD_POOL_H